@@ -0,0 +1,270 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_BATCH_HPP
+#   define URI_BATCH_HPP
+
+#   include <uri/scanner.hpp>
+#   include <cstdint>
+#   include <limits>
+#   include <stdexcept>
+#   include <vector>
+
+namespace uri {
+
+    //
+    // A component's position as an offset from the start of the batch
+    // buffer.  Components the URI does not have (as opposed to ones that
+    // are present but empty) have a begin of absent.
+    //
+    struct offset_range {
+        static const std::uint32_t absent = 0xffffffff;
+
+        std::uint32_t begin;
+        std::uint32_t length;
+
+        bool present() const { return this->begin != absent; }
+    };
+
+
+    //
+    // Parse results for a batch of URIs, one column per component.  Row i
+    // of every column describes the i-th URI in the buffer.
+    //
+    struct component_columns {
+        std::vector<offset_range> uri, scheme, userinfo, host, port, path,
+            query, fragment;
+
+        //
+        // The host_type of each URI's host; reg_name_host where there is
+        // no host.
+        //
+        std::vector<std::uint8_t> host_type;
+
+        //
+        // Bit i is set if the i-th URI was matched in its entirety.
+        //
+        std::vector<std::uint64_t> valid;
+
+        std::size_t size() const
+        {
+            return this->uri.size();
+        }
+
+        bool is_valid(const std::size_t i) const
+        {
+            return (this->valid[i / 64] >> (i % 64)) & 1;
+        }
+
+        void reserve(const std::size_t n)
+        {
+            this->uri.reserve(n);
+            this->scheme.reserve(n);
+            this->userinfo.reserve(n);
+            this->host.reserve(n);
+            this->port.reserve(n);
+            this->path.reserve(n);
+            this->query.reserve(n);
+            this->fragment.reserve(n);
+            this->host_type.reserve(n);
+            this->valid.reserve((n + 63) / 64);
+        }
+
+        void clear()
+        {
+            this->uri.clear();
+            this->scheme.clear();
+            this->userinfo.clear();
+            this->host.clear();
+            this->port.clear();
+            this->path.clear();
+            this->query.clear();
+            this->fragment.clear();
+            this->host_type.clear();
+            this->valid.clear();
+        }
+
+        //
+        // Append the rows of other after the rows of *this.
+        //
+        void append(const component_columns & other)
+        {
+            const std::size_t n = this->size();
+            this->uri.insert(this->uri.end(),
+                             other.uri.begin(), other.uri.end());
+            this->scheme.insert(this->scheme.end(),
+                                other.scheme.begin(), other.scheme.end());
+            this->userinfo.insert(this->userinfo.end(),
+                                  other.userinfo.begin(),
+                                  other.userinfo.end());
+            this->host.insert(this->host.end(),
+                              other.host.begin(), other.host.end());
+            this->port.insert(this->port.end(),
+                              other.port.begin(), other.port.end());
+            this->path.insert(this->path.end(),
+                              other.path.begin(), other.path.end());
+            this->query.insert(this->query.end(),
+                               other.query.begin(), other.query.end());
+            this->fragment.insert(this->fragment.end(),
+                                  other.fragment.begin(),
+                                  other.fragment.end());
+            this->host_type.insert(this->host_type.end(),
+                                   other.host_type.begin(),
+                                   other.host_type.end());
+            for (std::size_t i = 0; i < other.size(); ++i) {
+                this->push_valid(n + i, other.is_valid(i));
+            }
+        }
+
+        //
+        // Record the validity of row; rows must be pushed in order.
+        //
+        void push_valid(const std::size_t row, const bool is_valid)
+        {
+            if (row % 64 == 0) { this->valid.push_back(0); }
+            if (is_valid) {
+                this->valid.back() |= std::uint64_t(1) << (row % 64);
+            }
+        }
+    };
+
+
+    namespace detail {
+
+        //
+        // r as offsets from base, or an absent range if present is not
+        // set.
+        //
+        inline offset_range
+        make_offset_range(const char * const base,
+                          const boost::iterator_range<const char *> & r,
+                          const bool present)
+        {
+            if (!present) {
+                const offset_range absent = { offset_range::absent, 0 };
+                return absent;
+            }
+            const offset_range result = {
+                std::uint32_t(r.begin() - base), std::uint32_t(r.size())
+            };
+            return result;
+        }
+
+        class delimiter_set {
+            bool contains_[256];
+
+        public:
+            explicit delimiter_set(const char * delimiters):
+                contains_()
+            {
+                for (; *delimiters; ++delimiters) {
+                    this->contains_[static_cast<unsigned char>(*delimiters)] =
+                        true;
+                }
+            }
+
+            bool operator()(const char c) const
+            {
+                return this->contains_[static_cast<unsigned char>(c)];
+            }
+        };
+
+        //
+        // offset_range::absent is itself a 32-bit offset; so a buffer must
+        // be shorter than it for an empty component at the very end to
+        // be told from an absent one.
+        //
+        inline void check_batch_size(const char * const first,
+                                     const char * const last)
+        {
+            if (std::size_t(last - first)
+                >= std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("uri: batch buffer reaches the "
+                                        "range of 32-bit offsets");
+            }
+        }
+
+        //
+        // Append a row to columns for each record in [first, last).
+        // Offsets are relative to base.
+        //
+        inline void append_batch(const char * const base,
+                                 const char * const first,
+                                 const char * const last,
+                                 const delimiter_set & is_delimiter,
+                                 component_columns & columns)
+        {
+            components<const char *> c;
+            for (const char * record = first; record != last;) {
+                const char * record_end = record;
+                while (record_end != last && !is_delimiter(*record_end)) {
+                    ++record_end;
+                }
+
+                if (record_end != record) {
+                    c = components<const char *>();
+                    const char * pos = record;
+                    scan(pos, record_end, c);
+
+                    const offset_range whole = {
+                        std::uint32_t(record - base),
+                        std::uint32_t(record_end - record)
+                    };
+                    columns.push_valid(columns.size(), pos == record_end);
+                    columns.uri.push_back(whole);
+                    columns.scheme.push_back(make_offset_range(
+                        base, c.scheme, c.present & scheme_present));
+                    columns.userinfo.push_back(make_offset_range(
+                        base, c.userinfo, c.present & userinfo_present));
+                    columns.host.push_back(make_offset_range(
+                        base, c.host, c.present & host_present));
+                    columns.port.push_back(make_offset_range(
+                        base, c.port, c.present & port_present));
+                    columns.path.push_back(make_offset_range(
+                        base, c.path, c.present & path_present));
+                    columns.query.push_back(make_offset_range(
+                        base, c.query, c.present & query_present));
+                    columns.fragment.push_back(make_offset_range(
+                        base, c.fragment, c.present & fragment_present));
+                    columns.host_type.push_back(std::uint8_t(
+                        (c.present & host_present) ? c.address.type
+                                                   : reg_name_host));
+                }
+
+                record = (record_end == last) ? last : record_end + 1;
+            }
+        }
+    }
+
+
+    //
+    // Parse every URI in [first, last) into columns, replacing its
+    // contents.  URIs are separated by any of the characters in
+    // delimiters; empty records are skipped.  All offsets are relative to
+    // first, so the buffer must be shorter than offset_range::absent
+    // (4 GiB less a byte); std::length_error is thrown otherwise.
+    //
+    // A single scanner pass is made over each record; no per-URI
+    // allocation occurs beyond the growth of the columns themselves.
+    //
+    inline void parse_batch(const char * const first, const char * const last,
+                            component_columns & columns,
+                            const char * const delimiters = "\n")
+    {
+        detail::check_batch_size(first, last);
+        columns.clear();
+        detail::append_batch(first, first, last,
+                             detail::delimiter_set(delimiters), columns);
+    }
+} // namespace uri
+
+# endif // ifndef URI_BATCH_HPP
@@ -0,0 +1,345 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_BUILDER_HPP
+#   define URI_BUILDER_HPP
+
+#   include <uri/compact_uri.hpp>
+#   include <algorithm>
+#   include <cstring>
+#   include <iterator>
+#   include <string>
+
+namespace uri {
+
+    namespace detail {
+
+        struct build_length_sink {
+            std::size_t length;
+
+            build_length_sink(): length(0) {}
+
+            void put(char) { ++this->length; }
+
+            template <typename Iterator>
+            void put(const Iterator first, const Iterator last)
+            {
+                this->length += std::distance(first, last);
+            }
+        };
+
+        struct build_write_sink {
+            char * out;
+
+            explicit build_write_sink(char * const out): out(out) {}
+
+            void put(const char c) { *this->out++ = c; }
+
+            template <typename Iterator>
+            void put(const Iterator first, const Iterator last)
+            {
+                this->out = std::copy(first, last, this->out);
+            }
+        };
+
+        //
+        // Whether Grammar matches [first, last) in its entirety.  The
+        // grammar is built once per type, on first use.
+        //
+        template <typename Grammar>
+        bool matches_all(const char * first, const char * const last)
+        {
+            static const Grammar g;
+            return boost::spirit::qi::parse(first, last, g) && first == last;
+        }
+
+        //
+        // Whether [first, last) is a path that can follow what precedes
+        // it: path-abempty after an authority; otherwise path-absolute,
+        // path-empty, or (with a scheme) path-rootless or (without one)
+        // path-noscheme.
+        //
+        template <typename Iterator>
+        bool valid_path(const Iterator first, const Iterator last,
+                        const bool authority, const bool scheme)
+        {
+            if (authority) {
+                static const path_abempty_grammar<Iterator> g;
+                Iterator i = first;
+                return boost::spirit::qi::parse(i, last, g) && i == last;
+            }
+            if (first == last) { return true; }
+            if (*first == '/') {
+                static const path_absolute_grammar<Iterator> g;
+                Iterator i = first;
+                return boost::spirit::qi::parse(i, last, g) && i == last;
+            }
+            unsigned short segment_chars = segment_nz_nc_chars;
+            if (scheme) { segment_chars = pchar_class; }
+            const Iterator segment_end =
+                scan_pct_chars(first, last, segment_chars);
+            return segment_end != first
+                && (segment_end == last || *segment_end == '/')
+                && scan_pct_chars(segment_end, last, path_chars) == last;
+        }
+    }
+
+
+    //
+    // Writes the URI-reference that components describe, with any of them
+    // replaced or removed, as RFC 3986 (section 5.3) recomposes it: only
+    // the delimiters of the components that are present are written.
+    //
+    // c must have been default-constructed before it was filled in by a
+    // grammar (or the scanner), so that absent components can be told
+    // from empty ones; a default-constructed c describes an empty
+    // relative-ref.  An empty scheme counts as absent, as does a path.
+    // userinfo and port are written only when there is a host.
+    //
+    // Replacement text is not copied, and must outlive the builder.  It
+    // is written as it is; so it must already be pct-encoded.  validate
+    // checks that the result is what it should be.
+    //
+    // The builder itself does not allocate.  length gives the exact size
+    // of the output, and write fills a buffer of that size in one pass.
+    //
+    template <typename Iterator>
+    class uri_builder {
+    public:
+        typedef compact_uri::component component;
+
+    private:
+        enum piece_state {
+            kept,
+            replaced,
+            removed
+        };
+
+        struct piece {
+            piece_state state;
+            const char * first;
+            const char * last;
+        };
+
+        components<Iterator> components_;
+        piece pieces_[compact_uri::component_count];
+
+    public:
+        explicit uri_builder(const components<Iterator> & c =
+                                 components<Iterator>()):
+            components_(c)
+        {
+            for (int i = 0; i < compact_uri::component_count; ++i) {
+                const piece p = { kept, 0, 0 };
+                this->pieces_[i] = p;
+            }
+        }
+
+        uri_builder & set(const component which, const char * const first,
+                          const char * const last)
+        {
+            const piece p = { replaced, first, last };
+            this->pieces_[which] = p;
+            return *this;
+        }
+
+        uri_builder & set(const component which, const char * const text)
+        {
+            return this->set(which, text, text + std::strlen(text));
+        }
+
+        uri_builder & remove(const component which)
+        {
+            const piece p = { removed, 0, 0 };
+            this->pieces_[which] = p;
+            return *this;
+        }
+
+        //
+        // Whether the output is a URI-reference made of the components it
+        // is written from.  Each replaced component is matched against
+        // its rule (scheme, userinfo, host, port, query or fragment), and
+        // the path against the rule that applies where it ends up.  A
+        // replaced userinfo or port without a host fails.
+        //
+        bool validate() const;
+
+        std::size_t length() const
+        {
+            detail::build_length_sink sink;
+            this->put(sink);
+            return sink.length;
+        }
+
+        //
+        // Write the URI to out, which must have room for length()
+        // characters.  Returns the end of the output.
+        //
+        char * write(char * const out) const
+        {
+            detail::build_write_sink sink(out);
+            this->put(sink);
+            return sink.out;
+        }
+
+        //
+        // Replace the contents of out with the URI, resizing it once; it
+        // allocates only if out lacks the capacity.
+        //
+        void write(std::string & out) const
+        {
+            out.resize(this->length());
+            if (!out.empty()) { this->write(&out[0]); }
+        }
+
+        std::string str() const
+        {
+            std::string result;
+            this->write(result);
+            return result;
+        }
+
+    private:
+        const boost::iterator_range<Iterator> &
+        original(const component which) const
+        {
+            static boost::iterator_range<Iterator> components<Iterator>::*
+                const members[] = {
+                    &components<Iterator>::scheme,
+                    &components<Iterator>::userinfo,
+                    &components<Iterator>::host,
+                    &components<Iterator>::port,
+                    &components<Iterator>::path,
+                    &components<Iterator>::query,
+                    &components<Iterator>::fragment
+                };
+            return this->components_.*members[which];
+        }
+
+        bool present(const component which) const
+        {
+            const piece & p = this->pieces_[which];
+            switch (p.state) {
+            case replaced:
+                return which != compact_uri::scheme_component
+                    || p.first != p.last;
+            case removed:
+                return false;
+            default:
+                return which == compact_uri::scheme_component
+                    ? !this->original(which).empty()
+                    : (this->components_.present & (1u << which)) != 0;
+            }
+        }
+
+        template <typename Sink>
+        void put_component(const component which, Sink & sink) const
+        {
+            const piece & p = this->pieces_[which];
+            if (p.state == replaced) {
+                sink.put(p.first, p.last);
+            } else if (p.state == kept) {
+                const boost::iterator_range<Iterator> & r =
+                    this->original(which);
+                sink.put(r.begin(), r.end());
+            }
+        }
+
+        template <typename Sink>
+        void put(Sink & sink) const
+        {
+            if (this->present(compact_uri::scheme_component)) {
+                this->put_component(compact_uri::scheme_component, sink);
+                sink.put(':');
+            }
+            if (this->present(compact_uri::host_component)) {
+                sink.put('/');
+                sink.put('/');
+                if (this->present(compact_uri::userinfo_component)) {
+                    this->put_component(compact_uri::userinfo_component,
+                                        sink);
+                    sink.put('@');
+                }
+                this->put_component(compact_uri::host_component, sink);
+                if (this->present(compact_uri::port_component)) {
+                    sink.put(':');
+                    this->put_component(compact_uri::port_component, sink);
+                }
+            }
+            if (this->present(compact_uri::path_component)) {
+                this->put_component(compact_uri::path_component, sink);
+            }
+            if (this->present(compact_uri::query_component)) {
+                sink.put('?');
+                this->put_component(compact_uri::query_component, sink);
+            }
+            if (this->present(compact_uri::fragment_component)) {
+                sink.put('#');
+                this->put_component(compact_uri::fragment_component, sink);
+            }
+        }
+    };
+
+    template <typename Iterator>
+    bool uri_builder<Iterator>::validate() const
+    {
+        using namespace detail;
+
+        const bool authority = this->present(compact_uri::host_component);
+        for (int i = 0; i < compact_uri::component_count; ++i) {
+            const piece & p = this->pieces_[i];
+            if (p.state != replaced) { continue; }
+            bool valid = true;
+            switch (i) {
+            case compact_uri::scheme_component:
+                valid = p.first == p.last
+                    || matches_all<scheme_grammar<const char *> >(p.first,
+                                                                  p.last);
+                break;
+            case compact_uri::userinfo_component:
+                valid = authority
+                    && scan_pct_chars(p.first, p.last, userinfo_chars)
+                       == p.last;
+                break;
+            case compact_uri::host_component:
+                valid = matches_all<host_grammar<const char *> >(p.first,
+                                                                 p.last);
+                break;
+            case compact_uri::port_component:
+                valid = authority
+                    && scan_chars(p.first, p.last, digit_class) == p.last;
+                break;
+            case compact_uri::query_component:
+                valid = matches_all<query_grammar<const char *> >(p.first,
+                                                                  p.last);
+                break;
+            case compact_uri::fragment_component:
+                valid = matches_all<fragment_grammar<const char *> >(p.first,
+                                                                     p.last);
+                break;
+            }
+            if (!valid) { return false; }
+        }
+
+        const bool scheme = this->present(compact_uri::scheme_component);
+        const piece & path = this->pieces_[compact_uri::path_component];
+        if (path.state == replaced) {
+            return valid_path(path.first, path.last, authority, scheme);
+        }
+        if (path.state == removed) { return true; }
+        const boost::iterator_range<Iterator> & r =
+            this->original(compact_uri::path_component);
+        return valid_path(r.begin(), r.end(), authority, scheme);
+    }
+} // namespace uri
+
+# endif // ifndef URI_BUILDER_HPP
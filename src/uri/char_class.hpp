@@ -0,0 +1,189 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_CHAR_CLASS_HPP
+#   define URI_CHAR_CLASS_HPP
+
+namespace uri {
+
+    namespace detail {
+
+        enum char_class {
+            alpha_class      = 0x001,
+            digit_class      = 0x002,
+            xdigit_class     = 0x004,
+            unreserved_class = 0x008,
+            sub_delims_class = 0x010,
+            colon_class      = 0x020,
+            at_class         = 0x040,
+            slash_class      = 0x080,
+            question_class   = 0x100,
+            scheme_class     = 0x200,
+            pchar_class      = 0x400,
+            query_class      = 0x800
+        };
+
+        //
+        // Other classes are unions of the bits above; a character belongs
+        // to a class if any of the class's bits is set.
+        //
+        const unsigned short userinfo_chars =
+            unreserved_class | sub_delims_class | colon_class;
+        const unsigned short reg_name_chars =
+            unreserved_class | sub_delims_class;
+        const unsigned short segment_nz_nc_chars =
+            unreserved_class | sub_delims_class | at_class;
+        const unsigned short path_chars = pchar_class | slash_class;
+        const unsigned short query_chars = query_class;
+
+        //
+        // The tables every grammar and scanner tests characters against.
+        // As static members of a class template, each has a single
+        // definition however many translation units include this header.
+        //
+        // The classes mirror the char_ sets the grammars used to build,
+        // quirks included ("\" in sub-delims and "," in scheme), so that
+        // the grammars and the table-driven parsers agree byte for byte.
+        // Bytes outside ASCII belong to no class.
+        //
+        template <typename T = void>
+        struct char_tables {
+            static constexpr unsigned short classes[256] = {
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0xc10, 0x000, 0x000, 0xc10, 0x000, 0xc10, 0x000,
+                0xc10, 0xc10, 0xc10, 0xe10, 0xe10, 0xe08, 0xe08, 0x880,
+                0xe0e, 0xe0e, 0xe0e, 0xe0e, 0xe0e, 0xe0e, 0xe0e, 0xe0e,
+                0xe0e, 0xe0e, 0xc20, 0xc10, 0x000, 0xc10, 0x000, 0x900,
+                0xc40, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe09,
+                0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09,
+                0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09,
+                0xe09, 0xe09, 0xe09, 0x000, 0xc10, 0x000, 0x000, 0xc08,
+                0x000, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe0d, 0xe09,
+                0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09,
+                0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09, 0xe09,
+                0xe09, 0xe09, 0xe09, 0x000, 0x000, 0x000, 0xc08, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000,
+                0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000, 0x000
+            };
+
+            static constexpr unsigned char hex_values[256] = {
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+                0x08, 0x09, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+            };
+        };
+
+        template <typename T>
+        constexpr unsigned short char_tables<T>::classes[256];
+
+        template <typename T>
+        constexpr unsigned char char_tables<T>::hex_values[256];
+
+        constexpr unsigned short char_classes(const char c)
+        {
+            return char_tables<>::classes[static_cast<unsigned char>(c)];
+        }
+
+        //
+        // The value of the hex digit c, or 0xff if c is not one.
+        //
+        constexpr unsigned char hex_value(const char c)
+        {
+            return char_tables<>::hex_values[static_cast<unsigned char>(c)];
+        }
+
+        template <typename Iterator>
+        Iterator scan_chars(Iterator first, const Iterator last,
+                            const unsigned short chars)
+        {
+            while (first != last && (char_classes(*first) & chars)) {
+                ++first;
+            }
+            return first;
+        }
+
+        //
+        // Like scan_chars, but also consumes pct-encoded triples.  A "%"
+        // that is not followed by two hex digits ends the run, just as it
+        // ends the corresponding kleene star in the grammars.
+        //
+        template <typename Iterator>
+        Iterator scan_pct_chars(Iterator first, const Iterator last,
+                                const unsigned short chars)
+        {
+            while (first != last) {
+                if (char_classes(*first) & chars) {
+                    ++first;
+                    continue;
+                }
+                if (*first != '%') { break; }
+                Iterator i = first;
+                if (++i == last || !(char_classes(*i) & xdigit_class)) {
+                    break;
+                }
+                if (++i == last || !(char_classes(*i) & xdigit_class)) {
+                    break;
+                }
+                first = ++i;
+            }
+            return first;
+        }
+    }
+} // namespace uri
+
+# endif // ifndef URI_CHAR_CLASS_HPP
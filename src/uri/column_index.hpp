@@ -0,0 +1,357 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_COLUMN_INDEX_HPP
+#   define URI_COLUMN_INDEX_HPP
+
+//
+// A file of component_columns for a buffer of URIs, laid out so that it
+// can be used where it is mapped, without being read or copied.
+//
+// The file is a 64-byte index_header, then these sections, each starting
+// at a multiple of 64 bytes:
+//
+//   - the segments (index_segment, one per segment);
+//   - the columns uri, scheme, userinfo, host, port, path, query and
+//     fragment, in that order (offset_range, one per row);
+//   - the host types (one byte per row);
+//   - the valid bits (std::uint64_t, one bit per row).
+//
+// Offsets are 32-bit, so a large buffer is split into segments of up to
+// 1 GiB at record boundaries; a row's offsets are relative to the start
+// of its segment.  Integers are in the byte order of the machine that
+// wrote the file, which a reader on a machine of the other order rejects.
+//
+
+#   include <uri/batch.hpp>
+#   include <algorithm>
+#   include <cstring>
+#   include <ostream>
+
+namespace uri {
+
+    //
+    // A run of rows whose offsets are relative to base, the offset of the
+    // segment in the indexed buffer.
+    //
+    struct index_segment {
+        std::uint64_t first_row;
+        std::uint64_t base;
+    };
+
+    namespace detail {
+
+        const char index_magic[8] = { 'U', 'R', 'I', 'I', 'N', 'D', 'E', 'X' };
+        const std::uint32_t index_version = 1;
+        const std::uint32_t index_byte_order = 0x01020304;
+        const std::size_t index_column_count = 8;
+        const std::size_t max_index_segment = std::size_t(1) << 30;
+
+        struct index_header {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t byte_order;
+            std::uint64_t rows;
+            std::uint64_t segments;
+            std::uint64_t source_size;
+            std::uint64_t reserved[3];
+        };
+
+        static_assert(sizeof (index_header) == 64,
+                      "index_header is not 64 bytes");
+
+        inline std::uint64_t align_index(const std::uint64_t n)
+        {
+            return (n + 63) & ~std::uint64_t(63);
+        }
+
+        //
+        // Where each section of an index starts, and the size of the
+        // whole.
+        //
+        struct index_layout {
+            std::uint64_t segments, columns, column_stride, host_types,
+                valid, size;
+
+            index_layout(const std::uint64_t rows,
+                         const std::uint64_t segment_count):
+                segments(sizeof (index_header)),
+                columns(segments
+                        + align_index(segment_count * sizeof (index_segment))),
+                column_stride(align_index(rows * sizeof (offset_range))),
+                host_types(columns + index_column_count * column_stride),
+                valid(host_types + align_index(rows)),
+                size(valid + align_index((rows + 63) / 64 * 8))
+            {}
+        };
+
+        inline void write_index_section(std::ostream & out,
+                                        const void * const data,
+                                        const std::uint64_t size)
+        {
+            static const char padding[64] = {};
+            out.write(static_cast<const char *>(data), size);
+            out.write(padding, align_index(size) - size);
+        }
+
+        //
+        // The end of the segment that starts at first: the end of the last
+        // record that ends within max_index_segment bytes, or of the first
+        // record if that one is longer.
+        //
+        inline const char * index_segment_end(const char * const first,
+                                              const char * const last,
+                                              const delimiter_set &
+                                                  is_delimiter)
+        {
+            if (std::size_t(last - first) <= max_index_segment) {
+                return last;
+            }
+            const char * end = first + max_index_segment;
+            while (end != first && !is_delimiter(*(end - 1))) { --end; }
+            if (end != first) { return end; }
+            end = first + max_index_segment;
+            while (end != last && !is_delimiter(*end)) { ++end; }
+            return end == last ? last : end + 1;
+        }
+    }
+
+
+    //
+    // Parse every URI in [first, last), as parse_batch does, and write an
+    // index of the results to out.  The columns are built in memory
+    // before they are written, since each is contiguous in the file.
+    // Throws std::ios_base::failure if out fails.
+    //
+    inline void write_column_index(std::ostream & out,
+                                   const char * const first,
+                                   const char * const last,
+                                   const char * const delimiters = "\n")
+    {
+        const detail::delimiter_set is_delimiter(delimiters);
+        component_columns columns;
+        std::vector<index_segment> segments;
+        for (const char * segment = first; segment != last;) {
+            const char * const segment_end =
+                detail::index_segment_end(segment, last, is_delimiter);
+            detail::check_batch_size(segment, segment_end);
+            const index_segment s = {
+                columns.size(), std::uint64_t(segment - first)
+            };
+            segments.push_back(s);
+            detail::append_batch(segment, segment, segment_end,
+                                 is_delimiter, columns);
+            segment = segment_end;
+        }
+
+        detail::index_header header = {};
+        std::memcpy(header.magic, detail::index_magic, 8);
+        header.version = detail::index_version;
+        header.byte_order = detail::index_byte_order;
+        header.rows = columns.size();
+        header.segments = segments.size();
+        header.source_size = last - first;
+
+        const std::vector<offset_range> component_columns::* const
+            members[detail::index_column_count] = {
+                &component_columns::uri,
+                &component_columns::scheme,
+                &component_columns::userinfo,
+                &component_columns::host,
+                &component_columns::port,
+                &component_columns::path,
+                &component_columns::query,
+                &component_columns::fragment
+            };
+
+        out.write(reinterpret_cast<const char *>(&header), sizeof header);
+        detail::write_index_section(out, segments.data(),
+                                    segments.size() * sizeof (index_segment));
+        for (std::size_t i = 0; i < detail::index_column_count; ++i) {
+            const std::vector<offset_range> & column = columns.*members[i];
+            detail::write_index_section(out, column.data(),
+                                        column.size() * sizeof (offset_range));
+        }
+        detail::write_index_section(out, columns.host_type.data(),
+                                    columns.host_type.size());
+        detail::write_index_section(out, columns.valid.data(),
+                                    columns.valid.size() * 8);
+        if (!out.flush()) {
+            throw std::ios_base::failure("uri: writing column index failed");
+        }
+    }
+
+
+    //
+    // The columns of an index in memory, typically a mapping of the file.
+    // Nothing is copied: the ranges returned point into the memory, which
+    // must outlive the column_index and be aligned to at least 8 bytes
+    // (a mapping is aligned to a page).
+    //
+    class column_index {
+        const char * data_;
+        const detail::index_header * header_;
+        detail::index_layout layout_;
+
+    public:
+        //
+        // Throws std::runtime_error if [data, data + size) does not hold
+        // an index of this version and byte order.
+        //
+        column_index(const void * data, std::size_t size);
+
+        //
+        // The number of rows.
+        //
+        std::size_t size() const
+        {
+            return std::size_t(this->header_->rows);
+        }
+
+        //
+        // The size of the buffer the index was made from.
+        //
+        std::uint64_t source_size() const
+        {
+            return this->header_->source_size;
+        }
+
+        boost::iterator_range<const index_segment *> segments() const
+        {
+            const index_segment * const first =
+                this->section<index_segment>(this->layout_.segments);
+            return boost::make_iterator_range(
+                first, first + this->header_->segments);
+        }
+
+        //
+        // The offset in the indexed buffer that the offsets of row (less
+        // than size()) are relative to.
+        //
+        std::uint64_t base(std::size_t row) const;
+
+        boost::iterator_range<const offset_range *> uri() const
+        {
+            return this->column(0);
+        }
+
+        boost::iterator_range<const offset_range *> scheme() const
+        {
+            return this->column(1);
+        }
+
+        boost::iterator_range<const offset_range *> userinfo() const
+        {
+            return this->column(2);
+        }
+
+        boost::iterator_range<const offset_range *> host() const
+        {
+            return this->column(3);
+        }
+
+        boost::iterator_range<const offset_range *> port() const
+        {
+            return this->column(4);
+        }
+
+        boost::iterator_range<const offset_range *> path() const
+        {
+            return this->column(5);
+        }
+
+        boost::iterator_range<const offset_range *> query() const
+        {
+            return this->column(6);
+        }
+
+        boost::iterator_range<const offset_range *> fragment() const
+        {
+            return this->column(7);
+        }
+
+        //
+        // The host_type of each row, as in component_columns.
+        //
+        boost::iterator_range<const std::uint8_t *> host_types() const
+        {
+            const std::uint8_t * const first =
+                this->section<std::uint8_t>(this->layout_.host_types);
+            return boost::make_iterator_range(first, first + this->size());
+        }
+
+        bool is_valid(const std::size_t row) const
+        {
+            return (this->section<std::uint64_t>(this->layout_.valid)[row / 64]
+                    >> (row % 64)) & 1;
+        }
+
+    private:
+        template <typename T>
+        const T * section(const std::uint64_t offset) const
+        {
+            return reinterpret_cast<const T *>(this->data_ + offset);
+        }
+
+        boost::iterator_range<const offset_range *>
+        column(const std::size_t n) const
+        {
+            const offset_range * const first = this->section<offset_range>(
+                this->layout_.columns + n * this->layout_.column_stride);
+            return boost::make_iterator_range(first, first + this->size());
+        }
+    };
+
+    inline column_index::column_index(const void * const data,
+                                      const std::size_t size):
+        data_(static_cast<const char *>(data)),
+        header_(static_cast<const detail::index_header *>(data)),
+        layout_(0, 0)
+    {
+        if (size < sizeof (detail::index_header)
+            || std::memcmp(this->header_->magic, detail::index_magic, 8) != 0) {
+            throw std::runtime_error("uri: not a column index");
+        }
+        if (this->header_->version != detail::index_version) {
+            throw std::runtime_error("uri: unsupported column index version");
+        }
+        if (this->header_->byte_order != detail::index_byte_order) {
+            throw std::runtime_error("uri: column index has the wrong byte "
+                                     "order");
+        }
+        if (this->header_->rows > size || this->header_->segments > size) {
+            throw std::runtime_error("uri: column index is truncated");
+        }
+        this->layout_ = detail::index_layout(this->header_->rows,
+                                             this->header_->segments);
+        if (this->layout_.size > size) {
+            throw std::runtime_error("uri: column index is truncated");
+        }
+    }
+
+    inline std::uint64_t column_index::base(const std::size_t row) const
+    {
+        struct row_less {
+            bool operator()(const std::uint64_t r,
+                            const index_segment & s) const
+            {
+                return r < s.first_row;
+            }
+        };
+        const boost::iterator_range<const index_segment *> s =
+            this->segments();
+        return (std::upper_bound(s.begin(), s.end(), std::uint64_t(row),
+                                 row_less()) - 1)->base;
+    }
+} // namespace uri
+
+# endif // ifndef URI_COLUMN_INDEX_HPP
@@ -0,0 +1,363 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_COMPACT_URI_HPP
+#   define URI_COMPACT_URI_HPP
+
+#   include <uri/normalize.hpp>
+#   include <uri/scanner.hpp>
+#   include <cstring>
+#   include <limits>
+#   include <new>
+#   include <stdexcept>
+#   include <string>
+
+namespace uri {
+
+    //
+    // An owned, parsed URI in a single block of memory: a small header,
+    // the offsets of the components, and the text.  Offsets take 16 bits
+    // each when the text is shorter than 64 KiB and 32 bits otherwise.
+    // The object itself is one pointer, so moving it is a pointer copy.
+    //
+    // The block comes from operator new, or from an arena that the
+    // compact_uri does not free; the arena must then outlive it.
+    // Copies always allocate their own block.
+    //
+    class compact_uri {
+    public:
+        enum component {
+            scheme_component,
+            userinfo_component,
+            host_component,
+            port_component,
+            path_component,
+            query_component,
+            fragment_component,
+            component_count
+        };
+
+    private:
+        struct header {
+            std::uint32_t size;
+            std::uint8_t present;
+            std::uint8_t flags;
+        };
+
+        enum {
+            wide_offsets = 0x1,
+            owned_block = 0x2
+        };
+
+        char * block_;
+
+    public:
+        compact_uri(): block_(0) {}
+
+        //
+        // Throws std::invalid_argument if text is not a URI-reference in
+        // its entirety, and std::length_error if it is too long for
+        // 32-bit offsets.
+        //
+        explicit compact_uri(const std::string & text):
+            block_(0)
+        {
+            const char * first = text.data();
+            const char * const last = first + text.size();
+            const std::size_t size = check_size(first, last);
+            components<const char *> c;
+            scan(first, last, c);
+            if (first != last) {
+                throw std::invalid_argument("uri: text is not a "
+                                            "URI-reference");
+            }
+            this->block_ = static_cast<char *>(
+                ::operator new(block_size(size)));
+            this->init(text.data(), last, c, owned_block);
+        }
+
+        //
+        // [first, last) is the text a grammar (or the scanner) has
+        // matched, filling in c; Iterator must be random access.
+        //
+        template <typename Iterator>
+        compact_uri(const Iterator first, const Iterator last,
+                    const components<Iterator> & c):
+            block_(static_cast<char *>(
+                       ::operator new(block_size(check_size(first, last)))))
+        {
+            this->init(first, last, c, owned_block);
+        }
+
+        //
+        // As above, with the block obtained from arena.allocate(n), which
+        // must return storage aligned for std::uint32_t.
+        //
+        template <typename Iterator, typename Arena>
+        compact_uri(const Iterator first, const Iterator last,
+                    const components<Iterator> & c, Arena & arena):
+            block_(static_cast<char *>(
+                       arena.allocate(block_size(check_size(first, last)))))
+        {
+            this->init(first, last, c, 0);
+        }
+
+        compact_uri(const compact_uri & other):
+            block_(0)
+        {
+            if (!other.block_) { return; }
+            const std::size_t size = block_size(other.get_header().size);
+            this->block_ = static_cast<char *>(::operator new(size));
+            std::memcpy(this->block_, other.block_, size);
+            this->get_header().flags |= owned_block;
+        }
+
+        compact_uri(compact_uri && other): block_(other.block_)
+        {
+            other.block_ = 0;
+        }
+
+        ~compact_uri()
+        {
+            this->release();
+        }
+
+        compact_uri & operator=(const compact_uri & other)
+        {
+            if (this != &other) {
+                compact_uri copy(other);
+                this->swap(copy);
+            }
+            return *this;
+        }
+
+        compact_uri & operator=(compact_uri && other)
+        {
+            if (this != &other) {
+                this->release();
+                this->block_ = other.block_;
+                other.block_ = 0;
+            }
+            return *this;
+        }
+
+        void swap(compact_uri & other)
+        {
+            std::swap(this->block_, other.block_);
+        }
+
+        bool empty() const { return !this->block_; }
+
+        //
+        // The whole of the URI text, followed in memory by a null
+        // character.
+        //
+        boost::iterator_range<const char *> text() const
+        {
+            if (!this->block_) {
+                return boost::iterator_range<const char *>();
+            }
+            const char * const text = this->text_begin();
+            return boost::make_iterator_range(text,
+                                              text + this->get_header().size);
+        }
+
+        //
+        // Whether the URI has the component, empty or not.  Bit which of
+        // components::present is the component's.
+        //
+        bool has(const component which) const
+        {
+            return this->block_
+                && (this->get_header().present & (1u << which));
+        }
+
+        //
+        // A component as components<const char *> would hold it: an empty
+        // range if the URI does not have it.
+        //
+        boost::iterator_range<const char *> get(const component which) const
+        {
+            if (!this->has(which)) {
+                return boost::iterator_range<const char *>();
+            }
+            const char * const text = this->text_begin();
+            return boost::make_iterator_range(
+                text + this->offset(2 * which),
+                text + this->offset(2 * which + 1));
+        }
+
+        boost::iterator_range<const char *> scheme() const
+        {
+            return this->get(scheme_component);
+        }
+
+        boost::iterator_range<const char *> userinfo() const
+        {
+            return this->get(userinfo_component);
+        }
+
+        boost::iterator_range<const char *> host() const
+        {
+            return this->get(host_component);
+        }
+
+        boost::iterator_range<const char *> port() const
+        {
+            return this->get(port_component);
+        }
+
+        boost::iterator_range<const char *> path() const
+        {
+            return this->get(path_component);
+        }
+
+        boost::iterator_range<const char *> query() const
+        {
+            return this->get(query_component);
+        }
+
+        boost::iterator_range<const char *> fragment() const
+        {
+            return this->get(fragment_component);
+        }
+
+        //
+        // The components, for use with normalize, base_uri and the rest.
+        // The host address is not kept; it is the default.
+        //
+        components<const char *> to_components() const
+        {
+            components<const char *> c;
+            c.scheme = this->scheme();
+            c.userinfo = this->userinfo();
+            c.host = this->host();
+            c.port = this->port();
+            c.path = this->path();
+            c.query = this->query();
+            c.fragment = this->fragment();
+            c.present = this->block_ ? this->get_header().present : 0;
+            return c;
+        }
+
+        //
+        // The number of bytes of the block for a text of size characters.
+        //
+        static std::size_t block_size(const std::size_t size)
+        {
+            return sizeof (header) + offset_width(size) * 2 * component_count
+                + size + 1;
+        }
+
+    private:
+        static std::size_t offset_width(const std::size_t size)
+        {
+            return size < 0xffff ? sizeof (std::uint16_t)
+                                 : sizeof (std::uint32_t);
+        }
+
+        template <typename Iterator>
+        static std::size_t check_size(const Iterator first,
+                                      const Iterator last)
+        {
+            const std::size_t size = last - first;
+            if (size >= std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("uri: text exceeds the range of "
+                                        "32-bit offsets");
+            }
+            return size;
+        }
+
+        header & get_header() const
+        {
+            return *reinterpret_cast<header *>(this->block_);
+        }
+
+        char * offsets() const
+        {
+            return this->block_ + sizeof (header);
+        }
+
+        char * text_begin() const
+        {
+            return this->offsets()
+                + offset_width(this->get_header().size) * 2 * component_count;
+        }
+
+        std::uint32_t offset(const std::size_t i) const
+        {
+            if (this->get_header().flags & wide_offsets) {
+                return reinterpret_cast<const std::uint32_t *>(
+                    this->offsets())[i];
+            }
+            return reinterpret_cast<const std::uint16_t *>(this->offsets())[i];
+        }
+
+        void set_offset(const std::size_t i, const std::uint32_t value)
+        {
+            if (this->get_header().flags & wide_offsets) {
+                reinterpret_cast<std::uint32_t *>(this->offsets())[i] = value;
+            } else {
+                reinterpret_cast<std::uint16_t *>(this->offsets())[i] =
+                    std::uint16_t(value);
+            }
+        }
+
+        template <typename Iterator>
+        void init(const Iterator first, const Iterator last,
+                  const components<Iterator> & c, const std::uint8_t flags)
+        {
+            header & h = this->get_header();
+            h.size = std::uint32_t(last - first);
+            h.present = std::uint8_t(c.present);
+            h.flags = flags;
+            if (offset_width(h.size) == sizeof (std::uint32_t)) {
+                h.flags |= wide_offsets;
+            }
+
+            const boost::iterator_range<Iterator> * const ranges[] = {
+                &c.scheme, &c.userinfo, &c.host, &c.port, &c.path, &c.query,
+                &c.fragment
+            };
+            for (std::size_t i = 0; i < component_count; ++i) {
+                if (!(c.present & (1u << i))) {
+                    this->set_offset(2 * i, 0);
+                    this->set_offset(2 * i + 1, 0);
+                    continue;
+                }
+                this->set_offset(2 * i,
+                                 std::uint32_t(ranges[i]->begin() - first));
+                this->set_offset(2 * i + 1,
+                                 std::uint32_t(ranges[i]->end() - first));
+            }
+
+            char * const text = this->text_begin();
+            std::copy(first, last, text);
+            text[h.size] = '\0';
+        }
+
+        void release()
+        {
+            if (this->block_ && (this->get_header().flags & owned_block)) {
+                ::operator delete(this->block_);
+            }
+            this->block_ = 0;
+        }
+    };
+
+    inline void swap(compact_uri & a, compact_uri & b)
+    {
+        a.swap(b);
+    }
+} // namespace uri
+
+# endif // ifndef URI_COMPACT_URI_HPP
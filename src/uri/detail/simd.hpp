@@ -0,0 +1,180 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_DETAIL_SIMD_HPP
+#   define URI_DETAIL_SIMD_HPP
+
+#   include <cstddef>
+
+#   if defined(__GNUC__) && defined(__AVX2__)
+#     define URI_SIMD_AVX2 1
+#     include <immintrin.h>
+#   endif
+#   if defined(__GNUC__) && defined(__SSE2__)
+#     define URI_SIMD_SSE2 1
+#     include <emmintrin.h>
+#   endif
+
+namespace uri {
+
+    namespace detail {
+
+        //
+        // The vector searches of contiguous input share these.  A block
+        // is size characters loaded from p; its comparisons give a mask
+        // with bit i set where character i matches.  Masks of blocks
+        // loaded at different offsets line up as their positions do, so
+        // they combine with the ordinary bitwise operators.
+        //
+#   ifdef URI_SIMD_AVX2
+        struct block32 {
+            static const std::size_t size = 32;
+
+            __m256i v;
+
+            explicit block32(const char * const p):
+                v(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)))
+            {}
+
+            unsigned eq(const char c) const
+            {
+                return unsigned(_mm256_movemask_epi8(
+                    _mm256_cmpeq_epi8(this->v, _mm256_set1_epi8(c))));
+            }
+
+            //
+            // Where the character with bit 5 set is c (a lowercase
+            // letter): either case of c.
+            //
+            unsigned eq_folded(const char c) const
+            {
+                return unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                    _mm256_or_si256(this->v, _mm256_set1_epi8(0x20)),
+                    _mm256_set1_epi8(c))));
+            }
+        };
+#   endif
+
+#   ifdef URI_SIMD_SSE2
+        struct block16 {
+            static const std::size_t size = 16;
+
+            __m128i v;
+
+            explicit block16(const char * const p):
+                v(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)))
+            {}
+
+            unsigned eq(const char c) const
+            {
+                return unsigned(_mm_movemask_epi8(
+                    _mm_cmpeq_epi8(this->v, _mm_set1_epi8(c))));
+            }
+
+            unsigned eq_folded(const char c) const
+            {
+                return unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                    _mm_or_si128(this->v, _mm_set1_epi8(0x20)),
+                    _mm_set1_epi8(c))));
+            }
+        };
+#   endif
+
+        //
+        // The first position in [first, last) that test matches, or last.
+        // Test has
+        //
+        //   - lookahead, the number of characters past a position that
+        //     its test reads;
+        //   - block<Block>(p), the mask of the Block::size positions from
+        //     p that match; and
+        //   - at(p), whether the single position p matches.
+        //
+        // Blocks are tried with AVX2 (when the compiler targets it), then
+        // SSE2, then positions one at a time; positions too close to last
+        // for lookahead characters to follow never match.
+        //
+        template <typename Test>
+        const char * find_first(const char * first, const char * const last,
+                                const Test & test)
+        {
+#   ifdef URI_SIMD_AVX2
+            while (std::size_t(last - first) >= 32 + Test::lookahead) {
+                const unsigned mask = test.template block<block32>(first);
+                if (mask) { return first + __builtin_ctz(mask); }
+                first += 32;
+            }
+#   endif
+#   ifdef URI_SIMD_SSE2
+            while (std::size_t(last - first) >= 16 + Test::lookahead) {
+                const unsigned mask = test.template block<block16>(first);
+                if (mask) { return first + __builtin_ctz(mask); }
+                first += 16;
+            }
+#   endif
+            for (; std::size_t(last - first) > Test::lookahead; ++first) {
+                if (test.at(first)) { return first; }
+            }
+            return last;
+        }
+
+        //
+        // The number of positions in [first, last) that test matches.
+        //
+        template <typename Test>
+        std::size_t count_matches(const char * first, const char * const last,
+                                  const Test & test)
+        {
+            std::size_t n = 0;
+#   ifdef URI_SIMD_AVX2
+            for (; std::size_t(last - first) >= 32 + Test::lookahead;
+                 first += 32) {
+                n += __builtin_popcount(test.template block<block32>(first));
+            }
+#   endif
+#   ifdef URI_SIMD_SSE2
+            for (; std::size_t(last - first) >= 16 + Test::lookahead;
+                 first += 16) {
+                n += __builtin_popcount(test.template block<block16>(first));
+            }
+#   endif
+            for (; std::size_t(last - first) > Test::lookahead; ++first) {
+                n += test.at(first);
+            }
+            return n;
+        }
+
+        //
+        // A test for a single character.
+        //
+        struct char_test {
+            static const std::size_t lookahead = 0;
+
+            char c;
+
+            explicit char_test(const char c): c(c) {}
+
+            template <typename Block>
+            unsigned block(const char * const p) const
+            {
+                return Block(p).eq(this->c);
+            }
+
+            bool at(const char * const p) const
+            {
+                return *p == this->c;
+            }
+        };
+    }
+} // namespace uri
+
+# endif // ifndef URI_DETAIL_SIMD_HPP
@@ -0,0 +1,222 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_EXTRACT_HPP
+#   define URI_EXTRACT_HPP
+
+#   include <uri/detail/simd.hpp>
+#   include <uri/scanner.hpp>
+#   include <boost/iterator/iterator_facade.hpp>
+#   include <cstddef>
+
+namespace uri {
+
+    //
+    // A URI found in text: where it starts, all of it, and its components
+    // as scan assigns them.
+    //
+    struct extracted_uri {
+        std::size_t offset;
+        boost::iterator_range<const char *> text;
+        uri::components<const char *> components;
+    };
+
+    namespace detail {
+
+        //
+        // Matches a ":" followed by "/", or two "w"s in either case.  The
+        // test takes each character with the one after it, so a block is
+        // compared together with a second, overlapping one.
+        //
+        struct uri_candidate_test {
+            static const std::size_t lookahead = 1;
+
+            template <typename Block>
+            unsigned block(const char * const p) const
+            {
+                const Block v0(p), v1(p + 1);
+                return (v0.eq(':') & v1.eq('/'))
+                    | (v0.eq_folded('w') & v1.eq_folded('w'));
+            }
+
+            bool at(const char * const p) const
+            {
+                return (p[0] == ':' && p[1] == '/')
+                    || ((p[0] | 0x20) == 'w' && (p[1] | 0x20) == 'w');
+            }
+        };
+
+        //
+        // The first place in [first, last) that may start or be inside a
+        // URI worth looking at.  Returns last if there is none.
+        //
+        inline const char * find_uri_candidate(const char * const first,
+                                               const char * const last)
+        {
+            return find_first(first, last, uri_candidate_test());
+        }
+
+        //
+        // The start of the scheme that ends at colon, going back no
+        // further than floor; colon if there is none.
+        //
+        inline const char * scheme_start(const char * const floor,
+                                         const char * const colon)
+        {
+            const char * first = colon;
+            while (first != floor
+                   && (char_classes(*(first - 1)) & scheme_class)) {
+                --first;
+            }
+            while (first != colon && !(char_classes(*first) & alpha_class)) {
+                ++first;
+            }
+            return first;
+        }
+
+        inline bool starts_with_www(const char * const first,
+                                    const char * const last)
+        {
+            return last - first >= 4
+                && (first[0] | 0x20) == 'w' && (first[1] | 0x20) == 'w'
+                && (first[2] | 0x20) == 'w' && first[3] == '.';
+        }
+    }
+
+
+    //
+    // Iterates over the URIs in a buffer of text, finding each one only
+    // when it is reached.
+    //
+    // A URI is recognized by its "://": the scheme before it is taken as
+    // far back as scheme characters go (starting at a letter), and the
+    // URI runs as far as scan matches from there.  A word that starts
+    // with "www." is taken as the authority of a URI whose "scheme://"
+    // was left off; its scheme is empty, and its host and the rest are
+    // as scan would find them after "//".  Matches are the longest the
+    // grammar allows, so punctuation that may end a URI (such as a "."
+    // or "," after a path) is part of it.  URIs do not overlap; the
+    // search resumes where the last one ended.
+    //
+    class extract_iterator :
+        public boost::iterator_facade<extract_iterator,
+                                      const extracted_uri,
+                                      boost::forward_traversal_tag> {
+        friend class boost::iterator_core_access;
+
+        const char * base_;
+        const char * next_;
+        const char * last_;
+        extracted_uri uri_;
+
+    public:
+        extract_iterator(): base_(0), next_(0), last_(0)
+        {
+            this->uri_.offset = 0;
+        }
+
+        //
+        // An iterator at the first URI in [first, last); or if there is
+        // none, one equal to extract_iterator(last, last), the end.
+        //
+        extract_iterator(const char * const first, const char * const last):
+            base_(first),
+            next_(first),
+            last_(last)
+        {
+            this->load();
+        }
+
+    private:
+        void load()
+        {
+            const char * const floor = this->next_;
+            const char * from = this->next_;
+            for (;;) {
+                const char * const hit =
+                    detail::find_uri_candidate(from, this->last_);
+                if (hit == this->last_) {
+                    this->next_ = this->last_;
+                    this->uri_ = extracted_uri();
+                    this->uri_.offset = this->last_ - this->base_;
+                    this->uri_.text =
+                        boost::make_iterator_range(this->last_, this->last_);
+                    return;
+                }
+                from = hit + 1;
+
+                const char * first = hit;
+                components<const char *> c;
+                const char * end;
+                if (*hit == ':') {
+                    if (this->last_ - hit < 3 || hit[2] != '/') { continue; }
+                    first = detail::scheme_start(floor, hit);
+                    if (first == hit) { continue; }
+                    end = first;
+                    scan(end, this->last_, c);
+                } else {
+                    if (!detail::starts_with_www(hit, this->last_)
+                        || (hit != floor
+                            && ((detail::char_classes(*(hit - 1))
+                                 & detail::scheme_class)
+                                || *(hit - 1) == '/'
+                                || *(hit - 1) == '@'))) {
+                        continue;
+                    }
+                    c.scheme = boost::make_iterator_range(hit, hit);
+                    c.present |= scheme_present | path_present;
+                    const char * const authority_end =
+                        detail::scan_authority(hit, this->last_, c);
+                    const char * const path_end =
+                        detail::scan_path_abempty(authority_end, this->last_);
+                    c.path = boost::make_iterator_range(authority_end,
+                                                        path_end);
+                    end = detail::scan_query_fragment(path_end, this->last_,
+                                                      c);
+                }
+
+                this->uri_.offset = first - this->base_;
+                this->uri_.text = boost::make_iterator_range(first, end);
+                this->uri_.components = c;
+                this->next_ = end;
+                return;
+            }
+        }
+
+        const extracted_uri & dereference() const
+        {
+            return this->uri_;
+        }
+
+        void increment()
+        {
+            this->load();
+        }
+
+        bool equal(const extract_iterator & other) const
+        {
+            return this->uri_.text.begin() == other.uri_.text.begin();
+        }
+    };
+
+    //
+    // The URIs in [first, last).
+    //
+    inline boost::iterator_range<extract_iterator>
+    extract_uris(const char * const first, const char * const last)
+    {
+        return boost::make_iterator_range(extract_iterator(first, last),
+                                          extract_iterator(last, last));
+    }
+} // namespace uri
+
+# endif // ifndef URI_EXTRACT_HPP
@@ -13,101 +13,456 @@
 # ifndef URI_GRAMMAR_HPP
 #   define URI_GRAMMAR_HPP
 
+#   include <uri/char_class.hpp>
+#   include <uri/instrument.hpp>
 #   include <boost/fusion/include/boost_array.hpp>
 #   include <boost/fusion/include/std_pair.hpp>
 #   include <boost/spirit/include/qi.hpp>
 #   include <boost/spirit/include/phoenix.hpp>
+#   include <iterator>
 
 namespace uri {
 
+    namespace detail {
+
+        //
+        // Matches pct-encoded without synthesizing an attribute; used in
+        // place of pct_encoded_grammar where the grammars only need to
+        // validate the escape.
+        //
+        struct pct_encoded_parser :
+            boost::spirit::qi::primitive_parser<pct_encoded_parser> {
+
+            template <typename Context, typename Iterator>
+            struct attribute {
+                typedef boost::spirit::unused_type type;
+            };
+
+            template <typename Iterator, typename Context, typename Skipper,
+                      typename Attribute>
+            bool parse(Iterator & first, const Iterator & last, Context &,
+                       const Skipper & skipper, Attribute &) const
+            {
+                boost::spirit::qi::skip_over(first, last, skipper);
+                if (first == last || *first != '%') { return false; }
+                Iterator i = first;
+                if (++i == last || !(char_classes(*i) & xdigit_class)) {
+                    return false;
+                }
+                if (++i == last || !(char_classes(*i) & xdigit_class)) {
+                    return false;
+                }
+                first = ++i;
+                return true;
+            }
+
+            template <typename Context>
+            boost::spirit::info what(Context &) const
+            {
+                return boost::spirit::info("pct-encoded");
+            }
+        };
+
+        //
+        // Matches a single character of any of Classes, exposing it as
+        // its attribute.  This and pct_char_parser are what the grammars
+        // use in place of char_ sets; they test characters against the
+        // shared table and take no space in the grammar objects beyond
+        // that of an empty member.
+        //
+        template <unsigned short Classes>
+        struct char_class_parser :
+            boost::spirit::qi::primitive_parser<char_class_parser<Classes> > {
+
+            template <typename Context, typename Iterator>
+            struct attribute {
+                typedef char type;
+            };
+
+            template <typename Iterator, typename Context, typename Skipper,
+                      typename Attribute>
+            bool parse(Iterator & first, const Iterator & last, Context &,
+                       const Skipper & skipper, Attribute & attr) const
+            {
+                boost::spirit::qi::skip_over(first, last, skipper);
+                if (first == last || !(char_classes(*first) & Classes)) {
+                    return false;
+                }
+                boost::spirit::traits::assign_to(*first, attr);
+                ++first;
+                return true;
+            }
+
+            template <typename Context>
+            boost::spirit::info what(Context &) const
+            {
+                return boost::spirit::info("char-class");
+            }
+        };
+
+        //
+        // Matches a single character from First to Last, without
+        // synthesizing an attribute: the digit ranges of dec-octet, which
+        // the table has no classes for.
+        //
+        template <char First, char Last>
+        struct char_range_parser :
+            boost::spirit::qi::primitive_parser<
+                char_range_parser<First, Last> > {
+
+            template <typename Context, typename Iterator>
+            struct attribute {
+                typedef boost::spirit::unused_type type;
+            };
+
+            template <typename Iterator, typename Context, typename Skipper,
+                      typename Attribute>
+            bool parse(Iterator & first, const Iterator & last, Context &,
+                       const Skipper & skipper, Attribute &) const
+            {
+                boost::spirit::qi::skip_over(first, last, skipper);
+                if (first == last || *first < First || *first > Last) {
+                    return false;
+                }
+                ++first;
+                return true;
+            }
+
+            template <typename Context>
+            boost::spirit::info what(Context &) const
+            {
+                return boost::spirit::info("char-range");
+            }
+        };
+
+        //
+        // Matches a single character of any of Classes or a pct-encoded
+        // triple, without synthesizing an attribute.
+        //
+        template <unsigned short Classes>
+        struct pct_char_parser :
+            boost::spirit::qi::primitive_parser<pct_char_parser<Classes> > {
+
+            template <typename Context, typename Iterator>
+            struct attribute {
+                typedef boost::spirit::unused_type type;
+            };
+
+            template <typename Iterator, typename Context, typename Skipper,
+                      typename Attribute>
+            bool parse(Iterator & first, const Iterator & last,
+                       Context & context, const Skipper & skipper,
+                       Attribute & attr) const
+            {
+                boost::spirit::qi::skip_over(first, last, skipper);
+                if (first != last && (char_classes(*first) & Classes)) {
+                    ++first;
+                    return true;
+                }
+                return pct_encoded_parser().parse(first, last, context,
+                                                  skipper, attr);
+            }
+
+            template <typename Context>
+            boost::spirit::info what(Context &) const
+            {
+                return boost::spirit::info("pct-char");
+            }
+        };
+
+        //
+        // Matches scheme ":" in a single table-driven pass, exposing the
+        // scheme as its attribute.
+        //
+        // This is how the grammars choose between URI and relative-ref.
+        // A relative-ref cannot have a ":" before its first "/", "?" or
+        // "#"; since none of those is a scheme character, this parser
+        // fails on reaching the first of them (or any other non-scheme
+        // character) without consuming input.  Once it succeeds, the rest
+        // of the URI alternative cannot fail; so the relative-ref
+        // alternative never reparses input the URI alternative has
+        // already been over beyond that leading run of scheme characters.
+        //
+        struct scheme_colon_parser :
+            boost::spirit::qi::primitive_parser<scheme_colon_parser> {
+
+            template <typename Context, typename Iterator>
+            struct attribute {
+                typedef boost::iterator_range<Iterator> type;
+            };
+
+            template <typename Iterator, typename Context, typename Skipper,
+                      typename Attribute>
+            bool parse(Iterator & first, const Iterator & last, Context &,
+                       const Skipper & skipper, Attribute & attr) const
+            {
+                boost::spirit::qi::skip_over(first, last, skipper);
+                if (first == last || !(char_classes(*first) & alpha_class)) {
+                    return false;
+                }
+                Iterator i = first;
+                i = scan_chars(++i, last, scheme_class);
+                if (i == last || *i != ':') { return false; }
+                boost::spirit::traits::assign_to(
+                    boost::iterator_range<Iterator>(first, i), attr);
+                first = ++i;
+                return true;
+            }
+
+            template <typename Context>
+            boost::spirit::info what(Context &) const
+            {
+                return boost::spirit::info("scheme-colon");
+            }
+        };
+    }
+
+    namespace detail {
+
+        //
+        // The value of a dotted-decimal IPv4address that ipv4_grammar has
+        // already validated, with the first octet in the high-order byte.
+        //
+        template <typename Iterator>
+        std::uint32_t
+        ipv4_value(const boost::iterator_range<Iterator> & address)
+        {
+            std::uint32_t value = 0, octet = 0;
+            for (Iterator i = address.begin(); i != address.end(); ++i) {
+                if (*i == '.') {
+                    value = (value << 8) | octet;
+                    octet = 0;
+                } else {
+                    octet = octet * 10 + (*i - '0');
+                }
+            }
+            return (value << 8) | octet;
+        }
+    }
+
+    //
+    // The IPv4address rule of RFC 3986.  As with ipv6_grammar, the address
+    // is matched first and converted afterward; ipv4address itself has no
+    // semantic actions, for grammars that only recognize addresses.
+    //
     template <typename Iterator>
     struct ipv4_grammar :
         boost::spirit::qi::grammar<Iterator, std::uint32_t()> {
 
-        ipv4_grammar(): ipv4_grammar::base_type(ipv4address)
+        ipv4_grammar(): ipv4_grammar::base_type(start)
         {
-            using boost::spirit::qi::eps;
-            using boost::spirit::qi::_1;
-            using boost::spirit::qi::_val;
-            using std::uint32_t;
+            using namespace boost::spirit::qi;
+
+            start
+                =   raw[ipv4address][
+                        _val = boost::phoenix::bind(
+                            &detail::ipv4_value<Iterator>, _1)
+                    ]
+                ;
 
             ipv4address
-                =   eps[_val = 0]
-                    >> dec_octet[_val  = (_1 << 24)] >> '.'
-                    >> dec_octet[_val |= (_1 << 16)] >> '.'
-                    >> dec_octet[_val |= (_1 << 8) ] >> '.'
-                    >> dec_octet[_val |= _1]
+                =   dec_octet >> '.' >> dec_octet >> '.'
+                    >> dec_octet >> '.' >> dec_octet
                 ;
 
+            //
+            // The RFC 3986 alternatives, so that this grammar matches
+            // exactly what host_grammar used to match on its own (a leading
+            // zero ends the octet rather than failing it).
+            //
             dec_octet
-                =   boost::spirit::qi::uint_parser<std::uint8_t, 10, 1, 3>()
+                =   "25" >> digit_0_5
+                |   '2' >> digit_0_4 >> digit
+                |   '1' >> digit >> digit
+                |   digit_1_9 >> digit
+                |   digit
                 ;
+
+            URI_INSTRUMENT_NODE(ipv4address);
+            URI_INSTRUMENT_NODE(dec_octet);
         }
 
+        boost::spirit::qi::rule<Iterator, std::uint32_t()> start;
+        boost::spirit::qi::rule<Iterator> ipv4address, dec_octet;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::digit_class> >::type digit;
+        typename boost::proto::terminal<
+            detail::char_range_parser<'0', '5'> >::type digit_0_5;
+        typename boost::proto::terminal<
+            detail::char_range_parser<'0', '4'> >::type digit_0_4;
+        typename boost::proto::terminal<
+            detail::char_range_parser<'1', '9'> >::type digit_1_9;
+    };
+
+    namespace detail {
+
         //
-        // dec_octet needs a uint32_t attribute so that bit shifting will work
-        // properly.
+        // The value of an IPv6address that ipv6_grammar has already
+        // validated: the groups before "::" go at the front, those after it
+        // at the back.
         //
-        boost::spirit::qi::rule<Iterator, std::uint32_t()> ipv4address,
-            dec_octet;
-    };
+        template <typename Iterator>
+        boost::array<std::uint16_t, 8>
+        ipv6_value(const boost::iterator_range<Iterator> & address)
+        {
+            std::uint16_t groups[8];
+            std::size_t n = 0, gap = 8;
+            Iterator i = address.begin();
+            const Iterator last = address.end();
+            while (i != last) {
+                if (*i == ':') {
+                    if (++i != last && *i == ':') {
+                        gap = n;
+                        ++i;
+                    }
+                    continue;
+                }
+
+                std::uint32_t value = 0;
+                Iterator j = i;
+                for (; j != last && hex_value(*j) < 16; ++j) {
+                    value = (value << 4) | hex_value(*j);
+                }
+                if (j != last && *j == '.') {
+                    //
+                    // The trailing IPv4address of ls32.
+                    //
+                    const std::uint32_t ipv4 =
+                        ipv4_value(boost::make_iterator_range(i, last));
+                    groups[n++] = std::uint16_t(ipv4 >> 16);
+                    groups[n++] = std::uint16_t(ipv4 & 0xffff);
+                    break;
+                }
+                groups[n++] = std::uint16_t(value);
+                i = j;
+            }
+
+            boost::array<std::uint16_t, 8> result = {{}};
+            if (gap == 8) { gap = n; }
+            std::copy(groups, groups + gap, result.begin());
+            std::copy(groups + gap, groups + n, result.end() - (n - gap));
+            return result;
+        }
+    }
 
+    //
+    // The IPv6address rule of RFC 3986.  The address is matched first and
+    // converted afterward, so that the alternatives that fail partway
+    // through leave nothing behind in the value.
+    //
     template <typename Iterator>
     struct ipv6_grammar :
-        boost::spirit::qi::grammar<Iterator, boost::spirit::qi::locals<unsigned>, boost::array<std::uint16_t, 8>()> {
+        boost::spirit::qi::grammar<Iterator, boost::array<std::uint16_t, 8>()> {
 
-        ipv6_grammar(): ipv6_grammar::base_type(ipv6address)
+        ipv6_grammar(): ipv6_grammar::base_type(start)
         {
-            using std::uint16_t;
-            using std::uint64_t;
-            using boost::array;
-            using boost::spirit::qi::eps;
-            using boost::spirit::qi::lit;
-            using boost::spirit::qi::repeat;
-            using boost::spirit::qi::_1;
-            using boost::spirit::qi::_a;
-            using boost::spirit::qi::_val;
-            using boost::phoenix::at_c;
-            using boost::phoenix::static_cast_;
+            using namespace boost::spirit::qi;
+
+            start
+                =   raw[ipv6address][
+                        _val = boost::phoenix::bind(
+                            &detail::ipv6_value<Iterator>, _1)
+                    ]
+                ;
 
             ipv6address
-                =                                                                                                                                               repeat(6)[h16[_val[_a++]    = _1] >> ':'] >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>()        ]                                                                            >> lit("::")[_a = 1] >> repeat(5)[h16[_val[_a++]    = _1] >> ':'] >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>()        ] >> -(                                             h16[at_c<0>(_val) = _1]) >> lit("::")[_a = 2] >> repeat(4)[h16[_val[_a++]    = _1] >> ':'] >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 1)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >> lit("::")[_a = 3] >> repeat(3)[h16[_val[_a++]    = _1] >> ':'] >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 2)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >> lit("::")[_a = 4] >> repeat(2)[h16[_val[_a++]    = _1] >> ':'] >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 3)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >>     "::"          >>           h16[at_c<5>(_val) = _1] >> ':'  >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 4)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >>     "::"                                                       >> ls32[at_c<6>(_val) = at_c<0>(_1), at_c<7>(_val) = at_c<1>(_1)]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 5)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >>     "::"          >>           h16[at_c<7>(_val) = _1]
-                |   eps[_val = array<uint16_t, 8>(), _a = 0] >> -(repeat(0, 6)[h16[_val[_a++] = _1] >> ':'] >> h16[_val[_a]      = _1]) >>     "::"
+                =                                                               repeat(6)[h16 >> ':'] >> ls32
+                |                                                       "::" >> repeat(5)[h16 >> ':'] >> ls32
+                |   -(                                          h16) >> "::" >> repeat(4)[h16 >> ':'] >> ls32
+                |   -(repeat(0, 1)[h16 >> ':' >> !lit(':')] >> h16) >> "::" >> repeat(3)[h16 >> ':'] >> ls32
+                |   -(repeat(0, 2)[h16 >> ':' >> !lit(':')] >> h16) >> "::" >> repeat(2)[h16 >> ':'] >> ls32
+                |   -(repeat(0, 3)[h16 >> ':' >> !lit(':')] >> h16) >> "::" >>           h16 >> ':'  >> ls32
+                |   -(repeat(0, 4)[h16 >> ':' >> !lit(':')] >> h16) >> "::"                          >> ls32
+                |   -(repeat(0, 5)[h16 >> ':' >> !lit(':')] >> h16) >> "::" >>           h16
+                |   -(repeat(0, 6)[h16 >> ':' >> !lit(':')] >> h16) >> "::"
+                ;
+
+            h16
+                =   repeat(1, 4)[xdigit]
                 ;
 
             ls32
                 =   h16 >> ':' >> h16
-                |   ipv4address[at_c<0>(_val) = (_1 >> 16),
-                                at_c<1>(_val) = (0x0000ffff & _1)]
+                |   ipv4.ipv4address
                 ;
 
-            BOOST_SPIRIT_DEBUG_NODES((ipv6address))
+            URI_INSTRUMENT_NODE(ipv6address);
+            URI_INSTRUMENT_NODE(h16);
+            URI_INSTRUMENT_NODE(ls32);
         }
 
-        boost::spirit::qi::rule<Iterator,
-                                std::pair<std::uint64_t, std::uint64_t>()>
+        boost::spirit::qi::rule<Iterator, boost::array<std::uint16_t, 8>()>
             start;
-        boost::spirit::qi::rule<Iterator,
-                                boost::spirit::qi::locals<unsigned>,
-                                boost::array<std::uint16_t, 8>()>
-            ipv6address;
-        boost::spirit::qi::rule<Iterator, std::pair<std::uint16_t, std::uint16_t>()> ls32;
-        boost::spirit::qi::uint_parser<std::uint16_t, 16, 1, 4> h16;
-        ipv4_grammar<Iterator> ipv4address;
+        boost::spirit::qi::rule<Iterator> ipv6address, h16, ls32;
+        ipv4_grammar<Iterator> ipv4;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::xdigit_class> >::type xdigit;
+    };
+
+    //
+    // What the host of an authority is.  The address is set for ipv4_host
+    // (with the first octet in the high-order byte) and ipv6_host (a group
+    // per element, in order); for the other types it is zero.
+    //
+    enum host_type {
+        reg_name_host,
+        ipv4_host,
+        ipv6_host,
+        ipvfuture_host
+    };
+
+    struct host_address {
+        host_type type;
+        std::uint32_t ipv4;
+        boost::array<std::uint16_t, 8> ipv6;
+
+        explicit host_address(const host_type type = reg_name_host):
+            type(type),
+            ipv4(0),
+            ipv6()
+        {}
+
+        explicit host_address(const std::uint32_t ipv4):
+            type(ipv4_host),
+            ipv4(ipv4),
+            ipv6()
+        {}
+
+        explicit host_address(const boost::array<std::uint16_t, 8> & ipv6):
+            type(ipv6_host),
+            ipv4(0),
+            ipv6(ipv6)
+        {}
+    };
+
+    //
+    // The bits of components::present, one for each component in the
+    // order they are declared.
+    //
+    enum component_present {
+        scheme_present   = 0x01,
+        userinfo_present = 0x02,
+        host_present     = 0x04,
+        port_present     = 0x08,
+        path_present     = 0x10,
+        query_present    = 0x20,
+        fragment_present = 0x40
     };
 
+    //
+    // present has the bit of each component that has been assigned, empty
+    // or not; the range of one that has not is empty and should not be
+    // compared with anything.  address is only meaningful when host has
+    // been assigned.
+    //
     template <typename Iterator>
     struct components {
         boost::iterator_range<Iterator> scheme, userinfo, host, port, path, query, fragment;
-    };
+        host_address address;
+        unsigned present;
 
+        components(): present(0) {}
+    };
 
     template <typename Iterator>
     struct sub_delims_grammar :
@@ -117,11 +472,14 @@ namespace uri {
         {
             using namespace boost::spirit::qi;
             sub_delims
-               %=   char_("!$&\\()*+,;=")
+               %=   sub_delims_char
                 ;
         }
 
         boost::spirit::qi::rule<Iterator, char()> sub_delims;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::sub_delims_class> >::type
+            sub_delims_char;
     };
 
 
@@ -138,6 +496,8 @@ namespace uri {
         }
 
         boost::spirit::qi::rule<Iterator, std::string()> pct_encoded;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::xdigit_class> >::type xdigit;
     };
 
 
@@ -150,12 +510,14 @@ namespace uri {
             using namespace boost::spirit::qi;
 
             unreserved
-               %=   alnum
-                |   char_("-._~")
+               %=   unreserved_char
                 ;
         }
 
         boost::spirit::qi::rule<Iterator, char()> unreserved;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::unreserved_class> >::type
+            unreserved_char;
     };
 
 
@@ -166,17 +528,14 @@ namespace uri {
             using namespace boost::spirit::qi;
 
             pchar
-                =   unreserved
-                |   pct_encoded
-                |   sub_delims
-                |   char_(":@")
+                =   pchar_char
                 ;
         }
 
         boost::spirit::qi::rule<Iterator> pchar;
-        sub_delims_grammar<Iterator> sub_delims;
-        pct_encoded_grammar<Iterator> pct_encoded;
-        unreserved_grammar<Iterator> unreserved;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type
+            pchar_char;
     };
 
 
@@ -186,83 +545,83 @@ namespace uri {
         {
             using namespace boost::spirit::qi;
             scheme
-                =   alpha >> *(alnum | char_("+-."))
+                =   alpha >> *scheme_char
                 ;
+
+            URI_INSTRUMENT_NODE(scheme);
         }
 
         boost::spirit::qi::rule<Iterator> scheme;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::alpha_class> >::type alpha;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::scheme_class> >::type
+            scheme_char;
     };
 
 
     template <typename Iterator>
-    struct authority_grammar : boost::spirit::qi::grammar<Iterator> {
-        explicit authority_grammar(components<Iterator> & c):
-            authority_grammar::base_type(authority),
-            components_(c)
+    struct host_grammar :
+        boost::spirit::qi::grammar<Iterator, host_address()> {
+        host_grammar(): host_grammar::base_type(host)
         {
             using namespace boost::spirit::qi;
-
-            userinfo
-                =  *(   unreserved
-                    |   pct_encoded
-                    |   sub_delims
-                    |   ':'
-                    )
-                ;
+            using boost::phoenix::construct;
+            using boost::phoenix::val;
 
             ip_literal
-                =   '[' >> (ipv6address | ipvfuture) >> ']'
+                =   '['
+                    >> (    ipv6address[_val = construct<host_address>(_1)]
+                       |    ipvfuture[_val = construct<host_address>(val(ipvfuture_host))]
+                       )
+                    >> ']'
                 ;
 
             ipvfuture
-                =   'v' >> +xdigit >> '.' >> +(unreserved | sub_delims | ':')
+                =   'v' >> +xdigit >> '.' >> +ipvfuture_char
                 ;
 
-            ipv6address
-                =                                                 repeat(6)[h16 >> ':'] >> ls32
-                |                                         "::" >> repeat(5)[h16 >> ':'] >> ls32
-                |   -(                            h16) >> "::" >> repeat(4)[h16 >> ':'] >> ls32
-                |   -(repeat(0, 1)[h16 >> ':'] >> h16) >> "::" >> repeat(3)[h16 >> ':'] >> ls32
-                |   -(repeat(0, 2)[h16 >> ':'] >> h16) >> "::" >> repeat(2)[h16 >> ':'] >> ls32
-                |   -(repeat(0, 3)[h16 >> ':'] >> h16) >> "::" >>           h16 >> ':'  >> ls32
-                |   -(repeat(0, 4)[h16 >> ':'] >> h16) >> "::"                          >> ls32
-                |   -(repeat(0, 5)[h16 >> ':'] >> h16) >> "::" >>           h16
-                |   -(repeat(0, 6)[h16 >> ':'] >> h16) >> "::"
+            reg_name
+                =  *reg_name_char
                 ;
 
-            h16
-                =   repeat(1, 4)[xdigit]
+            host
+                =   ip_literal[_val = _1]
+                |   ipv4address[_val = construct<host_address>(_1)]
+                |   reg_name[_val = construct<host_address>(val(reg_name_host))]
                 ;
 
-            ls32
-                =   h16 >> ':' >> h16
-                |   ipv4address
-                ;
+            URI_INSTRUMENT_NODE(host);
+            URI_INSTRUMENT_NODE(ip_literal);
+            URI_INSTRUMENT_NODE(ipvfuture);
+            URI_INSTRUMENT_NODE(reg_name);
+        }
 
-            ipv4address
-                =   dec_octet >> '.' >> dec_octet >> '.' >> dec_octet >> '.'
-                    >> dec_octet
-                ;
+        boost::spirit::qi::rule<Iterator, host_address()> host, ip_literal;
+        boost::spirit::qi::rule<Iterator> reg_name, ipvfuture;
+        ipv6_grammar<Iterator> ipv6address;
+        ipv4_grammar<Iterator> ipv4address;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::xdigit_class> >::type xdigit;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::userinfo_chars> >::type
+            ipvfuture_char;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::reg_name_chars> >::type
+            reg_name_char;
+    };
 
-            dec_octet
-                =   "25" >> char_("0-5")
-                |   '2' >> char_("0-4") >> digit
-                |   '1' >> repeat(2)[digit]
-                |   char_("1-9") >> digit
-                |   digit
-                ;
 
-            reg_name
-                =  *(   unreserved
-                    |   pct_encoded
-                    |   sub_delims
-                    )
-                ;
+    template <typename Iterator>
+    struct authority_grammar : boost::spirit::qi::grammar<Iterator> {
+        explicit authority_grammar(components<Iterator> & c):
+            authority_grammar::base_type(authority),
+            components_(c)
+        {
+            using namespace boost::spirit::qi;
 
-            host
-                =   ip_literal
-                |   ipv4address
-                |   reg_name
+            userinfo
+                =  *userinfo_char
                 ;
 
             port
@@ -272,34 +631,38 @@ namespace uri {
             authority
                 =  -(   raw[userinfo][boost::phoenix::ref(userinfo_temp_) = _1]
                         >> '@'
-                    )[
-                        boost::phoenix::ref(components_.userinfo) =
-                            boost::phoenix::ref(userinfo_temp_)
-                    ]
-                    >> raw[host][boost::phoenix::ref(components_.host) = _1]
-                    >> -(':' >> raw[port][boost::phoenix::ref(components_.port) = _1])
-                ;
-
-            BOOST_SPIRIT_DEBUG_NODE(authority);
-            BOOST_SPIRIT_DEBUG_NODE(host);
-            BOOST_SPIRIT_DEBUG_NODE(ipv4address);
-            BOOST_SPIRIT_DEBUG_NODE(ipv6address);
-            BOOST_SPIRIT_DEBUG_NODE(dec_octet);
-            BOOST_SPIRIT_DEBUG_NODE(reg_name);
-            BOOST_SPIRIT_DEBUG_NODE(ipv6address);
-            BOOST_SPIRIT_DEBUG_NODE(ls32);
-            BOOST_SPIRIT_DEBUG_NODE(h16);
+                        >> eps[(
+                            boost::phoenix::ref(components_.userinfo) =
+                                boost::phoenix::ref(userinfo_temp_),
+                            boost::phoenix::ref(components_.present) |=
+                                userinfo_present
+                        )]
+                    )
+                    >> raw[host[boost::phoenix::ref(components_.address) = _1]][(
+                           boost::phoenix::ref(components_.host) = _1,
+                           boost::phoenix::ref(components_.present) |= host_present
+                       )]
+                    >> -(':' >> raw[port][(
+                            boost::phoenix::ref(components_.port) = _1,
+                            boost::phoenix::ref(components_.present) |= port_present
+                        )])
+                ;
+
+            URI_INSTRUMENT_NODE(authority);
+            URI_INSTRUMENT_NODE(userinfo);
+            URI_INSTRUMENT_NODE(port);
         }
 
         components<Iterator> & components_;
         boost::iterator_range<Iterator> userinfo_temp_;
 
-        boost::spirit::qi::rule<Iterator> authority, ip_literal, ipv6address,
-            userinfo, host, port, reg_name, ipv4address, dec_octet, h16, ls32,
-            ipvfuture;
-        sub_delims_grammar<Iterator> sub_delims;
-        pct_encoded_grammar<Iterator> pct_encoded;
-        unreserved_grammar<Iterator> unreserved;
+        boost::spirit::qi::rule<Iterator> authority, userinfo, port;
+        host_grammar<Iterator> host;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::userinfo_chars> >::type
+            userinfo_char;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::digit_class> >::type digit;
     };
 
 
@@ -312,10 +675,13 @@ namespace uri {
             path_abempty
                 =   *('/' >> *pchar)
                 ;
+
+            URI_INSTRUMENT_NODE(path_abempty);
         }
 
         boost::spirit::qi::rule<Iterator> path_abempty;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
     };
 
 
@@ -328,10 +694,13 @@ namespace uri {
             path_absolute
                 =   '/' >> -(+pchar >> *('/' >> *pchar))
                 ;
+
+            URI_INSTRUMENT_NODE(path_absolute);
         }
 
         boost::spirit::qi::rule<Iterator> path_absolute;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
     };
 
 
@@ -353,13 +722,18 @@ namespace uri {
                 ;
 
             hier_part
-                =   "//" >> authority >> raw[path_abempty][
-                        boost::phoenix::ref(components_.path) = _1
-                    ]
-                |   raw[(path_absolute | path_rootless | path_empty)][
-                        boost::phoenix::ref(components_.path) = _1
-                    ]
+                =   "//" >> authority >> raw[path_abempty][(
+                        boost::phoenix::ref(components_.path) = _1,
+                        boost::phoenix::ref(components_.present) |= path_present
+                    )]
+                |   raw[(path_absolute | path_rootless | path_empty)][(
+                        boost::phoenix::ref(components_.path) = _1,
+                        boost::phoenix::ref(components_.present) |= path_present
+                    )]
                 ;
+
+            URI_INSTRUMENT_NODE(hier_part);
+            URI_INSTRUMENT_NODE(path_rootless);
         }
 
         components<Iterator> & components_;
@@ -368,7 +742,8 @@ namespace uri {
         authority_grammar<Iterator> authority;
         path_abempty_grammar<Iterator> path_abempty;
         path_absolute_grammar<Iterator> path_absolute;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
     };
 
 
@@ -378,12 +753,15 @@ namespace uri {
         {
             using namespace boost::spirit::qi;
             query
-                =  *(pchar | char_("/?"))
+                =  *query_char
                 ;
+
+            URI_INSTRUMENT_NODE(query);
         }
 
         boost::spirit::qi::rule<Iterator> query;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::query_class> >::type query_char;
     };
 
 
@@ -394,12 +772,15 @@ namespace uri {
         {
             using namespace boost::spirit::qi;
             fragment
-                =  *(pchar | char_("/?"))
+                =  *query_char
                 ;
+
+            URI_INSTRUMENT_NODE(fragment);
         }
 
         boost::spirit::qi::rule<Iterator> fragment;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::query_class> >::type query_char;
     };
 
 
@@ -413,11 +794,7 @@ namespace uri {
             using namespace boost::spirit::qi;
 
             segment_nz_nc
-                =  +(   unreserved 
-                    |   pct_encoded
-                    |   sub_delims
-                    |   '@'
-                    )
+                =  +segment_nz_nc_char
                 ;
 
             path_noscheme
@@ -429,34 +806,45 @@ namespace uri {
                 ;
 
             relative_part
-                =   "//" >> authority >> raw[path_abempty][
-                        boost::phoenix::ref(components_.path) = _1
-                    ]
-                |   raw[(path_absolute | path_noscheme | path_empty)][
-                        boost::phoenix::ref(components_.path) = _1
-                    ]
+                =   "//" >> authority >> raw[path_abempty][(
+                        boost::phoenix::ref(components_.path) = _1,
+                        boost::phoenix::ref(components_.present) |= path_present
+                    )]
+                |   raw[(path_absolute | path_noscheme | path_empty)][(
+                        boost::phoenix::ref(components_.path) = _1,
+                        boost::phoenix::ref(components_.present) |= path_present
+                    )]
                 ;
 
             relative_ref
                 =   relative_part
                     >> -('?'
-                    >> raw[query][boost::phoenix::ref(components_.query) = _1])
+                    >> raw[query][(
+                        boost::phoenix::ref(components_.query) = _1,
+                        boost::phoenix::ref(components_.present) |= query_present
+                    )])
                     >> -('#'
-                    >> raw[fragment][boost::phoenix::ref(components_.fragment) = _1])
+                    >> raw[fragment][(
+                        boost::phoenix::ref(components_.fragment) = _1,
+                        boost::phoenix::ref(components_.present) |= fragment_present
+                    )])
                 ;
 
-            BOOST_SPIRIT_DEBUG_NODE(relative_ref);
-            BOOST_SPIRIT_DEBUG_NODE(relative_part);
+            URI_INSTRUMENT_NODE(relative_ref);
+            URI_INSTRUMENT_NODE(relative_part);
+            URI_INSTRUMENT_NODE(path_noscheme);
+            URI_INSTRUMENT_NODE(segment_nz_nc);
         }
 
         components<Iterator> & components_;
 
         boost::spirit::qi::rule<Iterator> relative_ref, relative_part,
             path_noscheme, path_empty, segment_nz_nc;
-        sub_delims_grammar<Iterator> sub_delims;
-        pct_encoded_grammar<Iterator> pct_encoded;
-        unreserved_grammar<Iterator> unreserved;
-        pchar_grammar<Iterator> pchar;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::segment_nz_nc_chars> >::type
+            segment_nz_nc_char;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
         authority_grammar<Iterator> authority;
         query_grammar<Iterator> query;
         fragment_grammar<Iterator> fragment;
@@ -477,20 +865,31 @@ namespace uri {
             using namespace boost::spirit::qi;
 
             uri
-                =   raw[scheme][boost::phoenix::ref(components_.scheme) = _1]
-                    >> ':' >> hier_part
-                    >> -('?' >> raw[query][boost::phoenix::ref(components_.query) = _1])
-                    >> -('#' >> raw[fragment][boost::phoenix::ref(components_.fragment) = _1])
+                =   scheme_colon[(
+                        boost::phoenix::ref(components_.scheme) = _1,
+                        boost::phoenix::ref(components_.present) |= scheme_present
+                    )]
+                    >> hier_part
+                    >> -('?' >> raw[query][(
+                            boost::phoenix::ref(components_.query) = _1,
+                            boost::phoenix::ref(components_.present) |= query_present
+                        )])
+                    >> -('#' >> raw[fragment][(
+                            boost::phoenix::ref(components_.fragment) = _1,
+                            boost::phoenix::ref(components_.present) |= fragment_present
+                        )])
                 ;
 
             uri_reference
                 =   uri
-                |   raw[eps][boost::phoenix::ref(components_.scheme) = _1] >> relative_ref
+                |   raw[eps][(
+                        boost::phoenix::ref(components_.scheme) = _1,
+                        boost::phoenix::ref(components_.present) |= scheme_present
+                    )] >> relative_ref
                 ;
 
-            BOOST_SPIRIT_DEBUG_NODE(uri_reference);
-            BOOST_SPIRIT_DEBUG_NODE(uri);
-            BOOST_SPIRIT_DEBUG_NODE(hier_part);
+            URI_INSTRUMENT_NODE(uri_reference);
+            URI_INSTRUMENT_NODE(uri);
         }
 
         typedef boost::spirit::qi::rule<Iterator> rule_t;
@@ -498,7 +897,8 @@ namespace uri {
         components<Iterator> & components_;
 
         rule_t uri_reference, uri;
-        scheme_grammar<Iterator> scheme;
+        typename boost::proto::terminal<detail::scheme_colon_parser>::type
+            scheme_colon;
         hier_part_grammar<Iterator> hier_part;
         relative_grammar<Iterator> relative_ref;
         query_grammar<Iterator> query;
@@ -516,9 +916,15 @@ namespace uri {
         {
             using namespace boost::spirit::qi;
             absolute_uri
-                =   raw[scheme][boost::phoenix::ref(components_.fragment) = _1]
+                =   raw[scheme][(
+                        boost::phoenix::ref(components_.fragment) = _1,
+                        boost::phoenix::ref(components_.present) |= fragment_present
+                    )]
                     >> ':' >> hier_part
-                    >> -('?' >> raw[query][boost::phoenix::ref(components_.fragment) = _1])
+                    >> -('?' >> raw[query][(
+                            boost::phoenix::ref(components_.fragment) = _1,
+                            boost::phoenix::ref(components_.present) |= fragment_present
+                        )])
                 ;
         }
 
@@ -529,6 +935,258 @@ namespace uri {
         hier_part_grammar<Iterator> hier_part;
         query_grammar<Iterator> query;
     };
+
+    //
+    // A grammar for URI-references that synthesizes components<Iterator>
+    // as its attribute rather than writing through a reference bound at
+    // construction.  An instance holds no per-parse state and is not
+    // modified by parsing; so a single const instance may be shared by
+    // any number of threads (given BOOST_SPIRIT_THREADSAFE):
+    //
+    //     static const uri::components_grammar<iterator> g;
+    //     uri::components<iterator> c;
+    //     qi::parse(first, last, g, c);
+    //
+    template <typename Iterator>
+    struct components_grammar :
+        boost::spirit::qi::grammar<Iterator, components<Iterator>()> {
+
+        components_grammar():
+            components_grammar::base_type(start)
+        {
+            using namespace boost::spirit::qi;
+            namespace phoenix = boost::phoenix;
+
+            typedef components<Iterator> c;
+
+            userinfo
+                =  *userinfo_char
+                ;
+
+            port
+                =   *digit
+                ;
+
+            authority
+                =  -(   raw[userinfo >> &lit('@')][(
+                            phoenix::bind(&c::userinfo, _r1) = _1,
+                            phoenix::bind(&c::present, _r1) |= userinfo_present
+                        )]
+                        >> '@'
+                    )
+                    >> raw[host[phoenix::bind(&c::address, _r1) = _1]][(
+                           phoenix::bind(&c::host, _r1) = _1,
+                           phoenix::bind(&c::present, _r1) |= host_present
+                       )]
+                    >> -(':' >> raw[port][(
+                            phoenix::bind(&c::port, _r1) = _1,
+                            phoenix::bind(&c::present, _r1) |= port_present
+                        )])
+                ;
+
+            path_rootless
+                =   +pchar >> *('/' >> *pchar)
+                ;
+
+            segment_nz_nc
+                =  +segment_nz_nc_char
+                ;
+
+            path_noscheme
+                =   segment_nz_nc >> *('/' >> *pchar)
+                ;
+
+            hier_part
+                =   "//" >> authority(_r1)
+                    >> raw[path_abempty][(
+                        phoenix::bind(&c::path, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= path_present
+                    )]
+                |   raw[(path_absolute | path_rootless | eps)][(
+                        phoenix::bind(&c::path, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= path_present
+                    )]
+                ;
+
+            relative_part
+                =   "//" >> authority(_r1)
+                    >> raw[path_abempty][(
+                        phoenix::bind(&c::path, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= path_present
+                    )]
+                |   raw[(path_absolute | path_noscheme | eps)][(
+                        phoenix::bind(&c::path, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= path_present
+                    )]
+                ;
+
+            query_fragment
+                =  -('?' >> raw[query][(
+                        phoenix::bind(&c::query, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= query_present
+                    )])
+                    >> -('#' >> raw[fragment][(
+                        phoenix::bind(&c::fragment, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= fragment_present
+                    )])
+                ;
+
+            uri_reference
+                =   scheme_colon[(
+                        phoenix::bind(&c::scheme, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= scheme_present
+                    )]
+                    >> hier_part(_r1) >> query_fragment(_r1)
+                |   raw[eps][(
+                        phoenix::bind(&c::scheme, _r1) = _1,
+                        phoenix::bind(&c::present, _r1) |= scheme_present
+                    )]
+                    >> relative_part(_r1) >> query_fragment(_r1)
+                ;
+
+            start
+                =   uri_reference(_val)
+                ;
+
+            URI_INSTRUMENT_NODE(uri_reference);
+            URI_INSTRUMENT_NODE(hier_part);
+            URI_INSTRUMENT_NODE(relative_part);
+            URI_INSTRUMENT_NODE(authority);
+        }
+
+        typedef boost::spirit::qi::rule<Iterator, void (components<Iterator> &)>
+            components_rule_t;
+
+        boost::spirit::qi::rule<Iterator, components<Iterator>()> start;
+        components_rule_t uri_reference, hier_part, relative_part, authority,
+            query_fragment;
+        boost::spirit::qi::rule<Iterator> userinfo, port, path_rootless,
+            path_noscheme, segment_nz_nc;
+        typename boost::proto::terminal<detail::scheme_colon_parser>::type
+            scheme_colon;
+        host_grammar<Iterator> host;
+        path_abempty_grammar<Iterator> path_abempty;
+        path_absolute_grammar<Iterator> path_absolute;
+        query_grammar<Iterator> query;
+        fragment_grammar<Iterator> fragment;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::userinfo_chars> >::type
+            userinfo_char;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::digit_class> >::type digit;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::segment_nz_nc_chars> >::type
+            segment_nz_nc_char;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
+    };
+
+    //
+    // A grammar that recognizes URI-references without capturing any of
+    // their components: it has no attribute and no semantic actions, so
+    // parsing with it only moves the iterator past what it matches.  It
+    // is made of the same rules as uri::grammar (IPv4 and IPv6 addresses
+    // are the recognizing rules of ipv4_grammar and ipv6_grammar) and
+    // matches exactly the same input.  Like components_grammar, an
+    // instance may be shared among threads.
+    //
+    template <typename Iterator>
+    struct validator_grammar : boost::spirit::qi::grammar<Iterator> {
+
+        validator_grammar():
+            validator_grammar::base_type(uri_reference)
+        {
+            using namespace boost::spirit::qi;
+
+            host
+                =   '[' >> (ipv6.ipv6address | ipvfuture) >> ']'
+                |   ipv4.ipv4address
+                |  *reg_name_char
+                ;
+
+            ipvfuture
+                =   'v' >> +xdigit >> '.' >> +ipvfuture_char
+                ;
+
+            authority
+                =  -(*userinfo_char >> '@') >> host >> -(':' >> *digit)
+                ;
+
+            path_rootless
+                =   +pchar >> *('/' >> *pchar)
+                ;
+
+            path_noscheme
+                =   +segment_nz_nc_char >> *('/' >> *pchar)
+                ;
+
+            hier_part
+                =   "//" >> authority >> path_abempty
+                |   path_absolute | path_rootless | eps
+                ;
+
+            relative_part
+                =   "//" >> authority >> path_abempty
+                |   path_absolute | path_noscheme | eps
+                ;
+
+            uri_reference
+                =   (scheme_colon >> hier_part | relative_part)
+                    >> -('?' >> query) >> -('#' >> fragment)
+                ;
+
+            URI_INSTRUMENT_NODE(uri_reference);
+            URI_INSTRUMENT_NODE(hier_part);
+            URI_INSTRUMENT_NODE(relative_part);
+            URI_INSTRUMENT_NODE(authority);
+            URI_INSTRUMENT_NODE(host);
+        }
+
+        boost::spirit::qi::rule<Iterator> uri_reference, hier_part,
+            relative_part, authority, host, ipvfuture, path_rootless,
+            path_noscheme;
+        typename boost::proto::terminal<detail::scheme_colon_parser>::type
+            scheme_colon;
+        ipv4_grammar<Iterator> ipv4;
+        ipv6_grammar<Iterator> ipv6;
+        path_abempty_grammar<Iterator> path_abempty;
+        path_absolute_grammar<Iterator> path_absolute;
+        query_grammar<Iterator> query;
+        fragment_grammar<Iterator> fragment;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::userinfo_chars> >::type
+            userinfo_char;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::reg_name_chars> >::type
+            reg_name_char;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::userinfo_chars> >::type
+            ipvfuture_char;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::xdigit_class> >::type xdigit;
+        typename boost::proto::terminal<
+            detail::char_class_parser<detail::digit_class> >::type digit;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::segment_nz_nc_chars> >::type
+            segment_nz_nc_char;
+        typename boost::proto::terminal<
+            detail::pct_char_parser<detail::pchar_class> >::type pchar;
+    };
+
+    //
+    // The length of the URI-reference at the start of [first, last); the
+    // input is a URI-reference in its entirety if that is last - first.
+    // The grammar is built once per Iterator type, on first use.
+    //
+    template <typename Iterator>
+    typename std::iterator_traits<Iterator>::difference_type
+    validate(Iterator first, const Iterator last)
+    {
+        static const validator_grammar<Iterator> g;
+        const Iterator begin = first;
+        boost::spirit::qi::parse(first, last, g);
+        return std::distance(begin, first);
+    }
 } // namespace uri
 
 # endif // ifndef URI_GRAMMAR_HPP
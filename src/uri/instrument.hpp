@@ -0,0 +1,320 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_INSTRUMENT_HPP
+#   define URI_INSTRUMENT_HPP
+
+//
+// Per-rule counters for the grammars, compiled in only when URI_INSTRUMENT
+// is defined.  Each rule named with URI_INSTRUMENT_NODE then counts the
+// times it is tried, the times it matches, the times it fails (so that
+// the caller backtracks), and the characters its matches consume.  With
+// URI_INSTRUMENT_CYCLES defined as well, it also accumulates the time
+// spent in it (including the rules it calls): TSC cycles on x86, and
+// nanoseconds elsewhere.
+//
+// Counts are kept per thread, without locking, and merged by
+// rule_snapshot.  Rules of the same name in different grammars (or
+// grammar instances) share counters.
+//
+// Without URI_INSTRUMENT, URI_INSTRUMENT_NODE is BOOST_SPIRIT_DEBUG_NODE
+// and rules are left exactly as they are; rule_snapshot returns nothing.
+//
+
+#   include <boost/spirit/include/qi.hpp>
+#   include <cstdint>
+#   include <string>
+#   include <vector>
+
+#   ifdef URI_INSTRUMENT
+#     include <boost/thread/mutex.hpp>
+#     include <atomic>
+#     include <iterator>
+#     ifdef URI_INSTRUMENT_CYCLES
+#       if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#         include <x86intrin.h>
+#       else
+#         include <chrono>
+#       endif
+#     endif
+#   endif
+
+namespace uri {
+
+    struct rule_statistics {
+        std::string name;
+        std::uint64_t invocations, successes, backtracks, bytes, cycles;
+    };
+
+#   ifdef URI_INSTRUMENT
+
+#     define URI_INSTRUMENT_NODE(r) \
+          BOOST_SPIRIT_DEBUG_NODE(r); ::uri::detail::instrument(r)
+
+    namespace detail {
+
+        const std::size_t max_instrumented_rules = 128;
+
+        inline std::uint64_t cycle_count()
+        {
+#     ifndef URI_INSTRUMENT_CYCLES
+            return 0;
+#     elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+            return __rdtsc();
+#     else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#     endif
+        }
+
+        //
+        // The counters of a rule for one thread.  Only that thread writes
+        // them, so an increment is a relaxed load and store; other threads
+        // may read them at any time.
+        //
+        struct rule_counters {
+            std::atomic<std::uint64_t> invocations, successes, backtracks,
+                bytes, cycles;
+
+            rule_counters():
+                invocations(0),
+                successes(0),
+                backtracks(0),
+                bytes(0),
+                cycles(0)
+            {}
+
+            static void add(std::atomic<std::uint64_t> & counter,
+                            const std::uint64_t n)
+            {
+                counter.store(counter.load(std::memory_order_relaxed) + n,
+                              std::memory_order_relaxed);
+            }
+        };
+
+        struct thread_counters;
+
+        //
+        // The names of the instrumented rules, the counters of the live
+        // threads, and the sums left by threads that have exited.
+        //
+        class rule_registry {
+            boost::mutex mutex_;
+            std::vector<std::string> names_;
+            std::vector<thread_counters *> threads_;
+            std::vector<rule_statistics> retired_;
+
+        public:
+            static rule_registry & instance()
+            {
+                static rule_registry registry;
+                return registry;
+            }
+
+            //
+            // The slot for the rule name, or max_instrumented_rules if
+            // there are no more.
+            //
+            std::size_t slot(const std::string & name);
+
+            void attach(thread_counters & t);
+            void detach(thread_counters & t);
+            std::vector<rule_statistics> snapshot();
+            void reset();
+
+        private:
+            void merge(const thread_counters & t,
+                       std::vector<rule_statistics> & stats) const;
+        };
+
+        struct thread_counters {
+            rule_counters rules[max_instrumented_rules];
+
+            thread_counters()
+            {
+                rule_registry::instance().attach(*this);
+            }
+
+            ~thread_counters()
+            {
+                rule_registry::instance().detach(*this);
+            }
+
+            static thread_counters & local()
+            {
+                static thread_local thread_counters counters;
+                return counters;
+            }
+        };
+
+        inline std::size_t rule_registry::slot(const std::string & name)
+        {
+            boost::mutex::scoped_lock lock(this->mutex_);
+            for (std::size_t i = 0; i < this->names_.size(); ++i) {
+                if (this->names_[i] == name) { return i; }
+            }
+            if (this->names_.size() == max_instrumented_rules) {
+                return max_instrumented_rules;
+            }
+            this->names_.push_back(name);
+            return this->names_.size() - 1;
+        }
+
+        inline void rule_registry::attach(thread_counters & t)
+        {
+            boost::mutex::scoped_lock lock(this->mutex_);
+            this->threads_.push_back(&t);
+        }
+
+        inline void rule_registry::detach(thread_counters & t)
+        {
+            boost::mutex::scoped_lock lock(this->mutex_);
+            this->merge(t, this->retired_);
+            for (std::size_t i = 0; i < this->threads_.size(); ++i) {
+                if (this->threads_[i] == &t) {
+                    this->threads_.erase(this->threads_.begin() + i);
+                    break;
+                }
+            }
+        }
+
+        inline void rule_registry::merge(const thread_counters & t,
+                                         std::vector<rule_statistics> & stats)
+            const
+        {
+            const rule_statistics zero = { std::string(), 0, 0, 0, 0, 0 };
+            stats.resize(this->names_.size(), zero);
+            for (std::size_t i = 0; i < this->names_.size(); ++i) {
+                const rule_counters & c = t.rules[i];
+                rule_statistics & s = stats[i];
+                s.name = this->names_[i];
+                s.invocations += c.invocations.load(std::memory_order_relaxed);
+                s.successes += c.successes.load(std::memory_order_relaxed);
+                s.backtracks += c.backtracks.load(std::memory_order_relaxed);
+                s.bytes += c.bytes.load(std::memory_order_relaxed);
+                s.cycles += c.cycles.load(std::memory_order_relaxed);
+            }
+        }
+
+        inline std::vector<rule_statistics> rule_registry::snapshot()
+        {
+            boost::mutex::scoped_lock lock(this->mutex_);
+            std::vector<rule_statistics> result = this->retired_;
+            const rule_statistics zero = { std::string(), 0, 0, 0, 0, 0 };
+            result.resize(this->names_.size(), zero);
+            for (std::size_t i = 0; i < this->names_.size(); ++i) {
+                result[i].name = this->names_[i];
+            }
+            for (std::size_t i = 0; i < this->threads_.size(); ++i) {
+                this->merge(*this->threads_[i], result);
+            }
+            return result;
+        }
+
+        inline void rule_registry::reset()
+        {
+            boost::mutex::scoped_lock lock(this->mutex_);
+            this->retired_.clear();
+            for (std::size_t i = 0; i < this->threads_.size(); ++i) {
+                for (std::size_t j = 0; j < this->names_.size(); ++j) {
+                    rule_counters & c = this->threads_[i]->rules[j];
+                    c.invocations = c.successes = c.backtracks = c.bytes =
+                        c.cycles = 0;
+                }
+            }
+        }
+
+        //
+        // Wraps the parse function of a rule, as qi::debug does.
+        //
+        template <typename Iterator, typename Context, typename Skipper>
+        struct instrument_handler {
+            typedef boost::function<bool (Iterator &, const Iterator &,
+                                          Context &, const Skipper &)>
+                function_type;
+
+            function_type subject;
+            std::size_t slot;
+
+            instrument_handler(const function_type & subject,
+                               const std::size_t slot):
+                subject(subject),
+                slot(slot)
+            {}
+
+            bool operator()(Iterator & first, const Iterator & last,
+                            Context & context, const Skipper & skipper) const
+            {
+                rule_counters & c = thread_counters::local().rules[this->slot];
+                rule_counters::add(c.invocations, 1);
+                const Iterator begin = first;
+                const std::uint64_t start = cycle_count();
+                const bool result = this->subject(first, last, context, skipper);
+                rule_counters::add(c.cycles, cycle_count() - start);
+                if (result) {
+                    rule_counters::add(c.successes, 1);
+                    rule_counters::add(c.bytes, std::distance(begin, first));
+                } else {
+                    rule_counters::add(c.backtracks, 1);
+                }
+                return result;
+            }
+        };
+
+        template <typename Iterator, typename T1, typename T2, typename T3,
+                  typename T4>
+        void instrument(boost::spirit::qi::rule<Iterator, T1, T2, T3, T4> & r)
+        {
+            typedef boost::spirit::qi::rule<Iterator, T1, T2, T3, T4>
+                rule_type;
+            const std::size_t slot = rule_registry::instance().slot(r.name());
+            if (slot == max_instrumented_rules) { return; }
+            r.f = instrument_handler<Iterator,
+                                     typename rule_type::context_type,
+                                     typename rule_type::skipper_type>(
+                r.f, slot);
+        }
+    }
+
+    //
+    // The counts of each instrumented rule, summed over every thread.
+    // Counts being made while the snapshot is taken may or may not be
+    // included.
+    //
+    inline std::vector<rule_statistics> rule_snapshot()
+    {
+        return detail::rule_registry::instance().snapshot();
+    }
+
+    //
+    // Zero the counts.  Counts being made at the same time may be lost.
+    //
+    inline void reset_rule_statistics()
+    {
+        detail::rule_registry::instance().reset();
+    }
+
+#   else // !URI_INSTRUMENT
+
+#     define URI_INSTRUMENT_NODE(r) BOOST_SPIRIT_DEBUG_NODE(r)
+
+    inline std::vector<rule_statistics> rule_snapshot()
+    {
+        return std::vector<rule_statistics>();
+    }
+
+    inline void reset_rule_statistics() {}
+
+#   endif
+} // namespace uri
+
+# endif // ifndef URI_INSTRUMENT_HPP
@@ -0,0 +1,496 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_NORMALIZE_HPP
+#   define URI_NORMALIZE_HPP
+
+#   include <uri/grammar.hpp>
+#   include <algorithm>
+#   include <cstring>
+
+namespace uri {
+
+    namespace detail {
+
+        inline char to_lower(const char c)
+        {
+            return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+        }
+
+        inline char upper_hex_digit(const unsigned char value)
+        {
+            return "0123456789ABCDEF"[value & 0x0f];
+        }
+
+        struct length_sink {
+            std::size_t length;
+            bool changed;
+
+            length_sink(): length(0), changed(false) {}
+
+            void put(char) { ++this->length; }
+            void note_change() { this->changed = true; }
+        };
+
+        struct write_sink {
+            char * out;
+
+            explicit write_sink(char * const out): out(out) {}
+
+            void put(const char c) { *this->out++ = c; }
+            void note_change() {}
+        };
+
+        //
+        // Put [first, last) to sink with pct-encoded unreserved characters
+        // decoded and the hex digits of the remaining escapes uppercased.
+        // If lowercase is set, letters outside escapes are lowercased.
+        //
+        template <typename Iterator, typename Sink>
+        void put_normalized(Iterator first, const Iterator last,
+                            const bool lowercase, Sink & sink)
+        {
+            while (first != last) {
+                if (*first == '%') {
+                    Iterator i = first;
+                    const char hi = *++i;
+                    const char lo = *++i;
+                    const char c = char((hex_value(hi) << 4) | hex_value(lo));
+                    if (char_classes(c) & unreserved_class) {
+                        sink.put(lowercase ? to_lower(c) : c);
+                        sink.note_change();
+                    } else {
+                        sink.put('%');
+                        sink.put(upper_hex_digit(hex_value(hi)));
+                        sink.put(upper_hex_digit(hex_value(lo)));
+                        if (hi >= 'a' || lo >= 'a') { sink.note_change(); }
+                    }
+                    first = ++i;
+                    continue;
+                }
+                const char c = *first++;
+                if (lowercase && c >= 'A' && c <= 'Z') {
+                    sink.put(to_lower(c));
+                    sink.note_change();
+                } else {
+                    sink.put(c);
+                }
+            }
+        }
+
+        //
+        // put_normalized, writing [first, last) backward so that it ends at
+        // end.  Returns the start of what was written.
+        //
+        // A character is the last of a pct-encoded triple exactly when the
+        // one two before it is "%": neither hex digit of a triple can be
+        // one.  Iterator must be bidirectional.
+        //
+        template <typename Iterator>
+        char * put_normalized_backward(const Iterator first, Iterator last,
+                                       const bool lowercase, char * end)
+        {
+            while (last != first) {
+                const char c = *--last;
+                Iterator pct = last;
+                if (pct != first && --pct != first && *--pct == '%') {
+                    const char hi = *std::next(pct);
+                    const char decoded =
+                        char((hex_value(hi) << 4) | hex_value(c));
+                    if (char_classes(decoded) & unreserved_class) {
+                        *--end = lowercase ? to_lower(decoded) : decoded;
+                    } else {
+                        *--end = upper_hex_digit(hex_value(c));
+                        *--end = upper_hex_digit(hex_value(hi));
+                        *--end = '%';
+                    }
+                    last = pct;
+                    continue;
+                }
+                *--end = lowercase ? to_lower(c) : c;
+            }
+            return end;
+        }
+
+        //
+        // 1 if [first, last) is ".", 2 if it is "..", and 0 otherwise.  If
+        // pct_dots is set, "%2E" counts as ".".
+        //
+        template <typename Iterator>
+        int dot_segment(Iterator first, const Iterator last,
+                        const bool pct_dots)
+        {
+            int dots = 0;
+            while (first != last) {
+                if (*first == '%' && pct_dots) {
+                    if (*++first != '2') { return 0; }
+                    if (*++first != 'e' && *first != 'E') { return 0; }
+                } else if (*first != '.') {
+                    return 0;
+                }
+                ++first;
+                if (++dots > 2) { return 0; }
+            }
+            return dots;
+        }
+
+        //
+        // The remove_dot_segments algorithm of RFC 3986, section 5.2.4,
+        // without an output buffer.
+        //
+        // The algorithm moves segments to its output and removes the last
+        // one on each "..".  Walking the path backward, each ".." instead
+        // becomes a count of preceding segments to skip; so the segments
+        // that survive can be visited, last to first, in a single pass and
+        // with no storage.  visitor.segment(first, last) is called for
+        // each, and visitor.changed() if any are removed.
+        //
+        // The work is split in three so that the resolver can apply it to
+        // a path merged from two pieces.
+        //
+
+        //
+        // Rules A and D: a relative path's leading "./" and "../" and a
+        // path of only "." or "..".  Returns the start of the rest of the
+        // path.
+        //
+        template <typename Iterator, typename Visitor>
+        Iterator skip_leading_dot_segments(Iterator first, const Iterator last,
+                                           const bool pct_dots,
+                                           Visitor & visitor)
+        {
+            while (first != last && *first != '/') {
+                Iterator segment_end = first;
+                while (segment_end != last && *segment_end != '/') {
+                    ++segment_end;
+                }
+                if (!dot_segment(first, segment_end, pct_dots)) { break; }
+                visitor.changed();
+                first = (segment_end == last) ? last : ++segment_end;
+            }
+            return first;
+        }
+
+        //
+        // Visit the surviving "/" segment pairs of [first, last), which is
+        // empty or starts with "/", backward.  If final, [first, last) ends
+        // the path, and rules B and C leave a "/" in place of a final "/."
+        // or "/..".  Returns the number of ".." segments that remain to be
+        // applied to whatever precedes first.
+        //
+        template <typename Iterator, typename Visitor>
+        std::size_t reverse_slash_segments(const Iterator first,
+                                           const Iterator last,
+                                           bool final, const bool pct_dots,
+                                           Visitor & visitor)
+        {
+            std::size_t skip = 0;
+            for (Iterator end = last; end != first; final = false) {
+                Iterator slash = end;
+                do { --slash; } while (*slash != '/');
+                Iterator segment = slash;
+                ++segment;
+
+                const int dots = dot_segment(segment, end, pct_dots);
+                if (dots == 0) {
+                    if (skip > 0) {
+                        --skip;
+                    } else {
+                        visitor.segment(slash, end);
+                    }
+                } else {
+                    visitor.changed();
+                    if (final) { visitor.segment(slash, segment); }
+                    if (dots == 2) { ++skip; }
+                }
+                end = slash;
+            }
+            return skip;
+        }
+
+        template <typename Iterator, typename Visitor>
+        void reverse_remove_dot_segments(Iterator first, const Iterator last,
+                                         const bool pct_dots,
+                                         Visitor & visitor)
+        {
+            first = skip_leading_dot_segments(first, last, pct_dots, visitor);
+
+            //
+            // What remains is an optional leading segment and a sequence
+            // of "/" segment.
+            //
+            Iterator rest = first;
+            while (rest != last && *rest != '/') { ++rest; }
+
+            const std::size_t skip =
+                reverse_slash_segments(rest, last, true, pct_dots, visitor);
+
+            if (first != rest) {
+                if (skip > 0) {
+                    visitor.changed();
+                } else {
+                    visitor.segment(first, rest);
+                }
+            }
+        }
+
+        template <typename Iterator>
+        struct path_length_visitor {
+            length_sink & sink;
+
+            explicit path_length_visitor(length_sink & sink): sink(sink) {}
+
+            void segment(const Iterator first, const Iterator last)
+            {
+                put_normalized(first, last, false, this->sink);
+            }
+
+            void changed()
+            {
+                this->sink.note_change();
+            }
+        };
+
+        //
+        // Writes segments backward from end, each in a single pass.
+        //
+        template <typename Iterator>
+        struct path_write_visitor {
+            char * end;
+
+            explicit path_write_visitor(char * const end): end(end) {}
+
+            void segment(const Iterator first, const Iterator last)
+            {
+                this->end = put_normalized_backward(first, last, false,
+                                                    this->end);
+            }
+
+            void changed() {}
+        };
+
+        inline const char * default_port(const char * const scheme,
+                                         const std::size_t scheme_length)
+        {
+            static const struct {
+                const char * scheme;
+                const char * port;
+            } ports[] = {
+                { "ftp",   "21"  },
+                { "http",  "80"  },
+                { "https", "443" },
+                { "ws",    "80"  },
+                { "wss",   "443" }
+            };
+            for (std::size_t i = 0; i < sizeof ports / sizeof ports[0]; ++i) {
+                if (std::strlen(ports[i].scheme) == scheme_length
+                    && std::equal(scheme, scheme + scheme_length,
+                                  ports[i].scheme)) {
+                    return ports[i].port;
+                }
+            }
+            return 0;
+        }
+
+        //
+        // Whether the port should be dropped: it is empty or the default
+        // for the scheme.
+        //
+        template <typename Iterator>
+        bool redundant_port(const components<Iterator> & c)
+        {
+            if (c.port.empty()) { return true; }
+
+            char scheme[8];
+            const std::size_t scheme_length = c.scheme.size();
+            if (scheme_length > sizeof scheme) { return false; }
+            std::transform(c.scheme.begin(), c.scheme.end(), scheme,
+                           to_lower);
+            const char * const port = default_port(scheme, scheme_length);
+            return port
+                && std::size_t(c.port.size()) == std::strlen(port)
+                && std::equal(c.port.begin(), c.port.end(), port);
+        }
+
+        //
+        // Put the scheme and authority, with their delimiters, to sink.
+        //
+        template <typename Iterator, typename Sink>
+        void put_normalized_prefix(const components<Iterator> & c,
+                                   Sink & sink)
+        {
+            if (!c.scheme.empty()) {
+                put_normalized(c.scheme.begin(), c.scheme.end(), true, sink);
+                sink.put(':');
+            }
+            if (c.present & host_present) {
+                sink.put('/');
+                sink.put('/');
+                if (c.present & userinfo_present) {
+                    put_normalized(c.userinfo.begin(), c.userinfo.end(),
+                                   false, sink);
+                    sink.put('@');
+                }
+                put_normalized(c.host.begin(), c.host.end(), true, sink);
+                if (c.present & port_present) {
+                    if (redundant_port(c)) {
+                        sink.note_change();
+                    } else {
+                        sink.put(':');
+                        put_normalized(c.port.begin(), c.port.end(), false,
+                                       sink);
+                    }
+                }
+            }
+        }
+
+        //
+        // Put everything but the path to sink, calling put_path at the
+        // point where the path goes.
+        //
+        template <typename Iterator, typename Sink, typename PutPath>
+        void put_normalized_uri(const components<Iterator> & c, Sink & sink,
+                                PutPath put_path)
+        {
+            put_normalized_prefix(c, sink);
+            put_path(sink);
+            if (c.present & query_present) {
+                sink.put('?');
+                put_normalized(c.query.begin(), c.query.end(), false, sink);
+            }
+            if (c.present & fragment_present) {
+                sink.put('#');
+                put_normalized(c.fragment.begin(), c.fragment.end(), false,
+                               sink);
+            }
+        }
+
+        template <typename Iterator>
+        struct path_length {
+            const components<Iterator> & c;
+
+            void operator()(length_sink & sink) const
+            {
+                if (this->c.scheme.empty()) {
+                    put_normalized(this->c.path.begin(), this->c.path.end(),
+                                   false, sink);
+                } else {
+                    path_length_visitor<Iterator> visitor(sink);
+                    reverse_remove_dot_segments(this->c.path.begin(),
+                                                this->c.path.end(), true,
+                                                visitor);
+                }
+            }
+        };
+
+        //
+        // Write the path, query and fragment backward so that they end at
+        // end, walking each once; the path's surviving segments come out
+        // of reverse_remove_dot_segments in just the order to write them.
+        // Returns the start of the path.
+        //
+        template <typename Iterator>
+        char * write_normalized_suffix(const components<Iterator> & c,
+                                       char * end)
+        {
+            if (c.present & fragment_present) {
+                end = put_normalized_backward(c.fragment.begin(),
+                                              c.fragment.end(), false, end);
+                *--end = '#';
+            }
+            if (c.present & query_present) {
+                end = put_normalized_backward(c.query.begin(), c.query.end(),
+                                              false, end);
+                *--end = '?';
+            }
+            if (c.scheme.empty()) {
+                return put_normalized_backward(c.path.begin(), c.path.end(),
+                                               false, end);
+            }
+            path_write_visitor<Iterator> visitor(end);
+            reverse_remove_dot_segments(c.path.begin(), c.path.end(), true,
+                                        visitor);
+            return visitor.end;
+        }
+    }
+
+
+    //
+    // The length of the syntax-based normalization (RFC 3986, section
+    // 6.2.2) of the URI-reference c describes, with the scheme-based
+    // removal of empty and default ports:
+    //
+    //   - the scheme and host are lowercased;
+    //   - pct-encoded unreserved characters are decoded, and the hex
+    //     digits of the other escapes uppercased;
+    //   - dot-segments are removed from the path of a URI (but not of a
+    //     relative-ref, where they are significant); and
+    //   - an empty port, or the default one for the scheme, is dropped.
+    //
+    // c must have been default-constructed before it was filled in by a
+    // grammar (or the scanner), so that its present bits are those of the
+    // components the URI has.
+    //
+    // changed is set to false if normalization would leave the URI as
+    // is; the caller can then use the original text without calling
+    // normalize.
+    //
+    template <typename Iterator>
+    std::size_t normalized_length(const components<Iterator> & c,
+                                  bool & changed)
+    {
+        detail::length_sink sink;
+        const detail::path_length<Iterator> path = { c };
+        detail::put_normalized_uri(c, sink, path);
+        changed = sink.changed;
+        return sink.length;
+    }
+
+    template <typename Iterator>
+    std::size_t normalized_length(const components<Iterator> & c)
+    {
+        bool changed;
+        return normalized_length(c, changed);
+    }
+
+    //
+    // Write the normalized URI to out, where length is
+    // normalized_length(c) and out has room for that many characters.
+    // Each component is read once: the path, query and fragment are
+    // written backward from the end of the output, and the scheme and
+    // authority forward from out.  Returns the end of the output.
+    //
+    // Iterator must be bidirectional.
+    //
+    template <typename Iterator>
+    char * normalize(const components<Iterator> & c, char * const out,
+                     const std::size_t length)
+    {
+        char * const end = out + length;
+        detail::write_normalized_suffix(c, end);
+        detail::write_sink sink(out);
+        detail::put_normalized_prefix(c, sink);
+        return end;
+    }
+
+    //
+    // As above, for a caller that has not already measured the output;
+    // this makes the measuring pass first.
+    //
+    template <typename Iterator>
+    char * normalize(const components<Iterator> & c, char * const out)
+    {
+        return normalize(c, out, normalized_length(c));
+    }
+} // namespace uri
+
+# endif // ifndef URI_NORMALIZE_HPP
@@ -0,0 +1,120 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_PARALLEL_HPP
+#   define URI_PARALLEL_HPP
+
+#   include <uri/batch.hpp>
+#   include <boost/thread.hpp>
+#   include <algorithm>
+#   include <atomic>
+#   include <exception>
+
+namespace uri {
+
+    namespace detail {
+
+        //
+        // Split [first, last) into chunks of roughly chunk_size bytes.
+        // Every chunk but the last ends just past a delimiter, so no record
+        // straddles two chunks.
+        //
+        inline std::vector<const char *>
+        chunk_bounds(const char * const first, const char * const last,
+                     const std::size_t chunk_size,
+                     const delimiter_set & is_delimiter)
+        {
+            std::vector<const char *> bounds(1, first);
+            for (const char * begin = first; begin != last;) {
+                const char * end =
+                    (std::size_t(last - begin) > chunk_size)
+                    ? begin + chunk_size
+                    : last;
+                while (end != last && !is_delimiter(*(end - 1))) { ++end; }
+                bounds.push_back(end);
+                begin = end;
+            }
+            return bounds;
+        }
+    }
+
+
+    //
+    // As parse_batch, but the buffer is parsed by up to threads threads
+    // (by default, one per hardware thread).  The result is identical to
+    // that of parse_batch, rows in input order.
+    //
+    // The buffer is cut at record boundaries into several chunks per
+    // thread; threads claim the next unparsed chunk as they finish their
+    // current one, so a thread held up by a slow chunk does not hold up
+    // the others.  Each chunk gets its own columns, which are concatenated
+    // once all threads have joined.
+    //
+    inline void parallel_parse(const char * const first, const char * const last,
+                               component_columns & columns,
+                               const char * const delimiters = "\n",
+                               unsigned threads = 0)
+    {
+        detail::check_batch_size(first, last);
+
+        if (threads == 0) {
+            threads = std::max(1u, boost::thread::hardware_concurrency());
+        }
+
+        const std::size_t min_chunk_size = 64 * 1024;
+        const std::size_t chunks_per_thread = 8;
+        const std::size_t chunk_size =
+            std::max(min_chunk_size,
+                     std::size_t(last - first) / (threads * chunks_per_thread)
+                     + 1);
+
+        const detail::delimiter_set is_delimiter(delimiters);
+        const std::vector<const char *> bounds =
+            detail::chunk_bounds(first, last, chunk_size, is_delimiter);
+        const std::size_t chunks = bounds.size() - 1;
+
+        std::vector<component_columns> results(chunks);
+        std::atomic<std::size_t> next_chunk(0);
+        std::exception_ptr error;
+        boost::mutex error_mutex;
+
+        const auto work = [&] {
+            for (std::size_t i; (i = next_chunk++) < chunks;) {
+                try {
+                    detail::append_batch(first, bounds[i], bounds[i + 1],
+                                         is_delimiter, results[i]);
+                } catch (...) {
+                    boost::lock_guard<boost::mutex> lock(error_mutex);
+                    if (!error) { error = std::current_exception(); }
+                }
+            }
+        };
+
+        boost::thread_group pool;
+        for (std::size_t t = 1; t < std::min(std::size_t(threads), chunks);
+             ++t) {
+            pool.create_thread(work);
+        }
+        work();
+        pool.join_all();
+
+        if (error) { std::rethrow_exception(error); }
+
+        std::size_t rows = 0;
+        for (const auto & r : results) { rows += r.size(); }
+        columns.clear();
+        columns.reserve(rows);
+        for (const auto & r : results) { columns.append(r); }
+    }
+} // namespace uri
+
+# endif // ifndef URI_PARALLEL_HPP
@@ -0,0 +1,262 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_PARSE_CACHE_HPP
+#   define URI_PARSE_CACHE_HPP
+
+#   include <uri/compact_uri.hpp>
+#   include <boost/thread.hpp>
+#   include <cstring>
+#   include <memory>
+#   include <vector>
+
+namespace uri {
+
+    namespace detail {
+
+        //
+        // A 64-bit hash of [first, last), taken a word at a time.
+        //
+        inline std::uint64_t hash_bytes(const char * first,
+                                        const char * const last)
+        {
+            const std::uint64_t k = 0xff51afd7ed558ccdULL;
+            std::uint64_t h =
+                0x9e3779b97f4a7c15ULL ^ std::uint64_t(last - first);
+            std::uint64_t word;
+            for (; last - first >= 8; first += 8) {
+                std::memcpy(&word, first, 8);
+                h = (h ^ word) * k;
+                h ^= h >> 32;
+            }
+            word = 0;
+            if (first != last) { std::memcpy(&word, first, last - first); }
+            h = (h ^ word) * k;
+            h ^= h >> 29;
+            return h;
+        }
+    }
+
+
+    //
+    // A bounded cache of scan results keyed by the bytes scanned, for
+    // workloads where a few distinct URIs make up most of the input.
+    //
+    // The cache is split into shards by hash, each with its own lock, so
+    // threads contend only when they look up URIs in the same shard.
+    // Within a shard, a URI can be in one set of four entries; a hit
+    // costs the hash of the input and a look at those four.  A full set
+    // evicts by CLOCK: entries are marked when hit, and the hand passes
+    // over (and unmarks) marked entries to find a victim.
+    //
+    // Scanning happens outside the lock.  Entries keep the input as a
+    // compact_uri, so each takes a single allocation.
+    //
+    class parse_cache {
+    public:
+        struct statistics {
+            std::uint64_t hits, misses, evictions;
+        };
+
+    private:
+        static const std::size_t ways = 4;
+
+        struct entry {
+            std::uint64_t hash;
+            compact_uri key;
+            std::uint32_t matched;
+            host_address address;
+            bool referenced;
+
+            entry(): hash(0), matched(0), referenced(false) {}
+        };
+
+        struct shard {
+            mutable boost::mutex mutex;
+            std::vector<entry> entries;
+            std::vector<unsigned char> hands;
+            statistics stats;
+
+            shard()
+            {
+                this->stats.hits = this->stats.misses =
+                    this->stats.evictions = 0;
+            }
+        };
+
+        std::size_t shard_count_, sets_;
+        std::unique_ptr<shard[]> shards_;
+
+    public:
+        //
+        // Room for at least capacity URIs, split among shards shards.
+        //
+        explicit parse_cache(const std::size_t capacity,
+                             const std::size_t shards = 16):
+            shard_count_(shards ? shards : 1),
+            sets_(1),
+            shards_(new shard[shard_count_])
+        {
+            const std::size_t per_shard =
+                (capacity + this->shard_count_ - 1) / this->shard_count_;
+            while (this->sets_ * ways < per_shard) { this->sets_ *= 2; }
+            for (std::size_t i = 0; i < this->shard_count_; ++i) {
+                this->shards_[i].entries.resize(this->sets_ * ways);
+                this->shards_[i].hands.resize(this->sets_);
+            }
+        }
+
+        //
+        // Equivalent to scan(first, last, c), assigning the ranges of a
+        // fresh scan.  The URI is [first, last) in its entirety; two inputs
+        // hit the same entry only if they are the same bytes.
+        //
+        bool parse(const char * & first, const char * const last,
+                   components<const char *> & c);
+
+        //
+        // The counts summed over all shards.
+        //
+        statistics stats() const;
+
+        void clear();
+
+    private:
+        static entry * find(entry * set, std::uint64_t hash,
+                            const char * first, const char * last);
+
+        static void use(const entry & e, const char * & first,
+                        components<const char *> & c);
+    };
+
+    inline bool parse_cache::parse(const char * & first,
+                                   const char * const last,
+                                   components<const char *> & c)
+    {
+        const std::uint64_t hash = detail::hash_bytes(first, last);
+        shard & s = this->shards_[hash % this->shard_count_];
+        entry * const set = &s.entries[
+            (std::size_t(hash / this->shard_count_) & (this->sets_ - 1))
+            * ways];
+
+        {
+            boost::mutex::scoped_lock lock(s.mutex);
+            if (entry * const e = find(set, hash, first, last)) {
+                e->referenced = true;
+                ++s.stats.hits;
+                use(*e, first, c);
+                return true;
+            }
+            ++s.stats.misses;
+        }
+
+        const char * const begin = first;
+        components<const char *> scanned;
+        const bool result = scan(first, last, scanned);
+        compact_uri key(begin, last, scanned);
+
+        boost::mutex::scoped_lock lock(s.mutex);
+        entry * victim = find(set, hash, begin, last);
+        if (!victim) {
+            unsigned char & hand = s.hands[(set - &s.entries[0]) / ways];
+            for (; !victim; hand = (hand + 1) % ways) {
+                entry & e = set[hand];
+                if (e.key.empty() || !e.referenced) {
+                    victim = &e;
+                } else {
+                    e.referenced = false;
+                }
+            }
+            if (!victim->key.empty()) { ++s.stats.evictions; }
+            victim->hash = hash;
+            victim->key = std::move(key);
+            victim->matched = std::uint32_t(first - begin);
+            victim->address = scanned.address;
+            victim->referenced = false;
+        }
+        first = begin;
+        use(*victim, first, c);
+        return result;
+    }
+
+    inline parse_cache::statistics parse_cache::stats() const
+    {
+        statistics result = { 0, 0, 0 };
+        for (std::size_t i = 0; i < this->shard_count_; ++i) {
+            boost::mutex::scoped_lock lock(this->shards_[i].mutex);
+            result.hits += this->shards_[i].stats.hits;
+            result.misses += this->shards_[i].stats.misses;
+            result.evictions += this->shards_[i].stats.evictions;
+        }
+        return result;
+    }
+
+    inline void parse_cache::clear()
+    {
+        for (std::size_t i = 0; i < this->shard_count_; ++i) {
+            boost::mutex::scoped_lock lock(this->shards_[i].mutex);
+            for (std::vector<entry>::iterator e =
+                     this->shards_[i].entries.begin();
+                 e != this->shards_[i].entries.end(); ++e) {
+                *e = entry();
+            }
+        }
+    }
+
+    inline parse_cache::entry *
+    parse_cache::find(entry * const set, const std::uint64_t hash,
+                      const char * const first, const char * const last)
+    {
+        const std::size_t size = last - first;
+        for (entry * e = set; e != set + ways; ++e) {
+            if (e->hash != hash || e->key.empty()) { continue; }
+            const boost::iterator_range<const char *> key = e->key.text();
+            if (std::size_t(key.size()) == size
+                && std::memcmp(key.begin(), first, size) == 0) {
+                return e;
+            }
+        }
+        return 0;
+    }
+
+    //
+    // Assign to c the components e has, as ranges of the input at first,
+    // and move first past the part of the input they cover.
+    //
+    inline void parse_cache::use(const entry & e, const char * & first,
+                                 components<const char *> & c)
+    {
+        const char * const text = e.key.text().begin();
+        boost::iterator_range<const char *> components<const char *>::*
+            const members[] = {
+                &components<const char *>::scheme,
+                &components<const char *>::userinfo,
+                &components<const char *>::host,
+                &components<const char *>::port,
+                &components<const char *>::path,
+                &components<const char *>::query,
+                &components<const char *>::fragment
+            };
+        for (int i = 0; i < compact_uri::component_count; ++i) {
+            const boost::iterator_range<const char *> r =
+                e.key.get(compact_uri::component(i));
+            if (!e.key.has(compact_uri::component(i))) { continue; }
+            c.*members[i] = boost::make_iterator_range(
+                first + (r.begin() - text), first + (r.end() - text));
+            c.present |= 1u << i;
+        }
+        c.address = e.address;
+        first += e.matched;
+    }
+} // namespace uri
+
+# endif // ifndef URI_PARSE_CACHE_HPP
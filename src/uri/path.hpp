@@ -0,0 +1,209 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_PATH_HPP
+#   define URI_PATH_HPP
+
+#   include <uri/detail/simd.hpp>
+#   include <boost/iterator/iterator_facade.hpp>
+#   include <boost/range/iterator_range.hpp>
+#   include <cassert>
+#   include <cstddef>
+
+namespace uri {
+
+    namespace detail {
+
+        template <typename Iterator>
+        Iterator find_slash(Iterator first, const Iterator last)
+        {
+            while (first != last && *first != '/') { ++first; }
+            return first;
+        }
+
+        inline const char * find_slash(const char * const first,
+                                       const char * const last)
+        {
+            return find_first(first, last, char_test('/'));
+        }
+
+        template <typename Iterator>
+        std::size_t count_slashes(Iterator first, const Iterator last)
+        {
+            std::size_t n = 0;
+            for (; first != last; ++first) { n += *first == '/'; }
+            return n;
+        }
+
+        inline std::size_t count_slashes(const char * const first,
+                                         const char * const last)
+        {
+            return count_matches(first, last, char_test('/'));
+        }
+
+        //
+        // Where the first segment of path begins: past the "/" of a
+        // path-abempty or path-absolute.
+        //
+        template <typename Iterator>
+        Iterator first_segment(const boost::iterator_range<Iterator> & path)
+        {
+            Iterator first = path.begin();
+            if (first != path.end() && *first == '/') { ++first; }
+            return first;
+        }
+    }
+
+
+    //
+    // Iterates over the segments of a path, finding each one only when it
+    // is reached.  The segments are those of the RFC 3986 path rules: a
+    // leading "/" precedes the first segment rather than ending an empty
+    // one, so "/a/b" has the segments "a" and "b", "/" has a single empty
+    // segment, and an empty path has none.  Segments are ranges of the
+    // path, still encoded.
+    //
+    template <typename Iterator>
+    class segment_iterator :
+        public boost::iterator_facade<segment_iterator<Iterator>,
+                                      const boost::iterator_range<Iterator>,
+                                      boost::forward_traversal_tag> {
+        friend class boost::iterator_core_access;
+
+        Iterator last_;
+        boost::iterator_range<Iterator> segment_;
+        bool end_;
+
+    public:
+        segment_iterator(): end_(true) {}
+
+        explicit segment_iterator(const boost::iterator_range<Iterator> & path):
+            last_(path.end()),
+            end_(path.empty())
+        {
+            if (!this->end_) { this->load(detail::first_segment(path)); }
+        }
+
+    private:
+        void load(const Iterator first)
+        {
+            this->segment_ = boost::make_iterator_range(
+                first, detail::find_slash(first, this->last_));
+        }
+
+        const boost::iterator_range<Iterator> & dereference() const
+        {
+            return this->segment_;
+        }
+
+        void increment()
+        {
+            Iterator next = this->segment_.end();
+            if (next == this->last_) {
+                this->end_ = true;
+                return;
+            }
+            this->load(++next);
+        }
+
+        bool equal(const segment_iterator & other) const
+        {
+            if (this->end_ || other.end_) { return this->end_ == other.end_; }
+            return this->segment_.begin() == other.segment_.begin();
+        }
+    };
+
+    template <typename Iterator>
+    boost::iterator_range<segment_iterator<Iterator> >
+    path_segments(const boost::iterator_range<Iterator> & path)
+    {
+        return boost::make_iterator_range(segment_iterator<Iterator>(path),
+                                          segment_iterator<Iterator>());
+    }
+
+    //
+    // The number of segments in path, counted without splitting it.
+    //
+    template <typename Iterator>
+    std::size_t segment_count(const boost::iterator_range<Iterator> & path)
+    {
+        if (path.empty()) { return 0; }
+        return detail::count_slashes(detail::first_segment(path), path.end())
+            + 1;
+    }
+
+    //
+    // Random access to the first N segments of a path, split once on
+    // construction into storage of its own.  Only as much of the path is
+    // scanned as those segments take; the remainder is left as rest for
+    // routes that match on a prefix.
+    //
+    template <typename Iterator, std::size_t N>
+    class segment_index {
+        boost::iterator_range<Iterator> segments_[N];
+        std::size_t size_;
+        bool complete_;
+        boost::iterator_range<Iterator> rest_;
+
+    public:
+        explicit segment_index(const boost::iterator_range<Iterator> & path):
+            size_(0),
+            complete_(true),
+            rest_(path.end(), path.end())
+        {
+            if (path.empty()) { return; }
+            Iterator first = detail::first_segment(path);
+            const Iterator last = path.end();
+            for (;;) {
+                if (this->size_ == N) {
+                    this->complete_ = false;
+                    this->rest_ = boost::make_iterator_range(first, last);
+                    return;
+                }
+                const Iterator slash = detail::find_slash(first, last);
+                this->segments_[this->size_++] =
+                    boost::make_iterator_range(first, slash);
+                if (slash == last) { return; }
+                first = slash;
+                ++first;
+            }
+        }
+
+        //
+        // The number of segments indexed; at most N.
+        //
+        std::size_t size() const { return this->size_; }
+
+        //
+        // Whether the path has no more segments than those indexed.
+        //
+        bool complete() const { return this->complete_; }
+
+        const boost::iterator_range<Iterator> &
+        operator[](const std::size_t i) const
+        {
+            assert(i < this->size_);
+            return this->segments_[i];
+        }
+
+        //
+        // The segments after the first N, unsplit.  A path with one more
+        // segment, empty, has an empty rest too; see complete.
+        //
+        const boost::iterator_range<Iterator> & rest() const
+        {
+            return this->rest_;
+        }
+    };
+} // namespace uri
+
+# endif // ifndef URI_PATH_HPP
@@ -0,0 +1,191 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_PCT_DECODE_HPP
+#   define URI_PCT_DECODE_HPP
+
+#   include <uri/char_class.hpp>
+#   include <uri/detail/simd.hpp>
+#   include <boost/iterator/iterator_facade.hpp>
+#   include <boost/range/iterator_range.hpp>
+#   include <algorithm>
+#   include <iterator>
+
+namespace uri {
+
+    //
+    // Decode the pct-encoded triples in [first, last), writing the result
+    // to out.  A "%" not followed by two hex digits is copied as is.
+    // Returns the end of the output, which holds at most last - first
+    // characters.
+    //
+    template <typename InputIterator, typename OutputIterator>
+    OutputIterator pct_decode(InputIterator first, const InputIterator last,
+                              OutputIterator out)
+    {
+        while (first != last) {
+            if (*first == '%') {
+                InputIterator i = first;
+                unsigned char hi = 0xff, lo = 0xff;
+                if (++i != last) { hi = detail::hex_value(*i); }
+                if (hi != 0xff && ++i != last) { lo = detail::hex_value(*i); }
+                if (lo != 0xff) {
+                    *out++ = char((hi << 4) | lo);
+                    first = ++i;
+                    continue;
+                }
+            }
+            *out++ = *first++;
+        }
+        return out;
+    }
+
+    namespace detail {
+
+        //
+        // Copy characters from first to out up to the next "%" or last,
+        // returning the position reached.
+        //
+        inline const char * copy_to_pct(const char * const first,
+                                        const char * const last,
+                                        char * & out)
+        {
+            const char * const pct = find_first(first, last, char_test('%'));
+            out = std::copy(first, pct, out);
+            return pct;
+        }
+    }
+
+    //
+    // Contiguous input: runs without "%" are skipped with SSE2 (or AVX2,
+    // when the compiler targets it) and each escape is decoded with a
+    // single table lookup per digit.  out may be first, to decode in
+    // place, since the output never gets ahead of the input; it may not
+    // overlap the input in any other way.
+    //
+    inline char * pct_decode(const char * first, const char * const last,
+                             char * out)
+    {
+        while (first != last) {
+            first = detail::copy_to_pct(first, last, out);
+            if (first == last) { break; }
+            if (last - first >= 3) {
+                const unsigned char hi = detail::hex_value(first[1]);
+                const unsigned char lo = detail::hex_value(first[2]);
+                if ((hi | lo) < 16) {
+                    *out++ = char((hi << 4) | lo);
+                    first += 3;
+                    continue;
+                }
+            }
+            *out++ = *first++;
+        }
+        return out;
+    }
+
+    inline char * pct_decode(char * const first, char * const last, char * out)
+    {
+        return pct_decode(static_cast<const char *>(first),
+                          static_cast<const char *>(last), out);
+    }
+
+    template <typename Iterator, typename OutputIterator>
+    OutputIterator pct_decode(const boost::iterator_range<Iterator> & range,
+                              OutputIterator out)
+    {
+        return pct_decode(range.begin(), range.end(), out);
+    }
+
+    //
+    // Iterates over the decoded characters of a range, decoding each
+    // escape as it is reached; as with pct_decode, a "%" not followed by
+    // two hex digits stands for itself.
+    //
+    template <typename Iterator>
+    class pct_decode_iterator :
+        public boost::iterator_facade<pct_decode_iterator<Iterator>,
+                                      const char,
+                                      boost::forward_traversal_tag,
+                                      char> {
+        friend class boost::iterator_core_access;
+
+        Iterator pos_, last_;
+        char value_;
+        unsigned char length_;
+
+    public:
+        pct_decode_iterator(): value_(0), length_(0) {}
+
+        pct_decode_iterator(const Iterator pos, const Iterator last):
+            pos_(pos),
+            last_(last),
+            value_(0),
+            length_(0)
+        {
+            this->load();
+        }
+
+        //
+        // The position in the encoded range.
+        //
+        const Iterator & base() const { return this->pos_; }
+
+    private:
+        void load()
+        {
+            if (this->pos_ == this->last_) { return; }
+            if (*this->pos_ == '%') {
+                Iterator i = this->pos_;
+                unsigned char hi = 0xff, lo = 0xff;
+                if (++i != this->last_) { hi = detail::hex_value(*i); }
+                if (hi != 0xff && ++i != this->last_) {
+                    lo = detail::hex_value(*i);
+                }
+                if (lo != 0xff) {
+                    this->value_ = char((hi << 4) | lo);
+                    this->length_ = 3;
+                    return;
+                }
+            }
+            this->value_ = *this->pos_;
+            this->length_ = 1;
+        }
+
+        char dereference() const { return this->value_; }
+
+        void increment()
+        {
+            std::advance(this->pos_, this->length_);
+            this->load();
+        }
+
+        bool equal(const pct_decode_iterator & other) const
+        {
+            return this->pos_ == other.pos_;
+        }
+    };
+
+    //
+    // A view of range with its escapes decoded.
+    //
+    template <typename Iterator>
+    boost::iterator_range<pct_decode_iterator<Iterator> >
+    pct_decoded(const boost::iterator_range<Iterator> & range)
+    {
+        typedef pct_decode_iterator<Iterator> iterator;
+        return boost::make_iterator_range(
+            iterator(range.begin(), range.end()),
+            iterator(range.end(), range.end()));
+    }
+} // namespace uri
+
+# endif // ifndef URI_PCT_DECODE_HPP
@@ -0,0 +1,710 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_PUSH_PARSER_HPP
+#   define URI_PUSH_PARSER_HPP
+
+#   include <uri/batch.hpp>
+
+namespace uri {
+
+    //
+    // The components of a URI as offsets from its first character.
+    // Components the parse did not assign are absent, just as the
+    // grammars leave them out of components::present.
+    //
+    struct offset_components {
+        offset_range scheme, userinfo, host, port, path, query, fragment;
+        host_address address;
+
+        offset_components()
+        {
+            const offset_range absent = { offset_range::absent, 0 };
+            this->scheme = this->userinfo = this->host = this->port =
+                this->path = this->query = this->fragment = absent;
+        }
+    };
+
+    namespace detail {
+
+        //
+        // scan_ipv4address, fed one character at a time.  All it keeps of
+        // the input is the digits of the current octet.
+        //
+        class ipv4_matcher {
+        public:
+            enum outcome {
+                no_match,
+                match,
+                prefix_match    // IPv4address matches only a proper prefix
+            };
+
+        private:
+            std::uint32_t value_;
+            unsigned char octets_, digits_;
+            char octet_[3];
+            bool done_;
+            outcome outcome_;
+
+        public:
+            ipv4_matcher():
+                value_(0),
+                octets_(0),
+                digits_(0),
+                done_(false),
+                outcome_(no_match)
+            {}
+
+            void push(const char c)
+            {
+                if (this->done_) { return; }
+                if (char_classes(c) & digit_class) {
+                    if (this->digits_ < 3) { this->octet_[this->digits_] = c; }
+                    if (this->digits_ < 4) { ++this->digits_; }
+                    return;
+                }
+                std::uint32_t value;
+                const std::size_t length = this->octet_length(value);
+                if (c == '.' && this->octets_ < 3) {
+                    if (length == 0 || length != this->digits_) {
+                        this->done_ = true;
+                        this->outcome_ = no_match;
+                        return;
+                    }
+                    this->value_ = (this->value_ << 8) | value;
+                    ++this->octets_;
+                    this->digits_ = 0;
+                    return;
+                }
+                this->done_ = true;
+                this->outcome_ = (this->octets_ == 3 && length > 0)
+                               ? prefix_match
+                               : no_match;
+            }
+
+            //
+            // The outcome for the input pushed so far, taken as the whole
+            // of the host.
+            //
+            outcome finish(std::uint32_t & address) const
+            {
+                if (this->done_) { return this->outcome_; }
+                if (this->octets_ < 3) { return no_match; }
+                std::uint32_t value;
+                const std::size_t length = this->octet_length(value);
+                if (length == 0) { return no_match; }
+                if (length != this->digits_) { return prefix_match; }
+                address = (this->value_ << 8) | value;
+                return match;
+            }
+
+        private:
+            std::size_t octet_length(std::uint32_t & value) const
+            {
+                const char * const last =
+                    this->octet_ + (this->digits_ < 3 ? this->digits_ : 3);
+                return scan_dec_octet(this->octet_, last, value)
+                    - this->octet_;
+            }
+        };
+    }
+
+
+    //
+    // An incremental equivalent of scan for URIs that arrive in pieces,
+    // such as request targets read off a socket.
+    //
+    // Each chunk passed to feed continues the same URI; the parser keeps
+    // none of the input, only a fixed amount of state (the longest part
+    // being an IP-literal, which is validated once its "]" arrives).
+    // feed fails as soon as a character makes it impossible for the input
+    // to be a prefix of a URI-reference.  After the last chunk, finish
+    // reports whether the input as a whole is one.  A URI is accepted if
+    // and only if scan would consume all of it; result then holds the
+    // offsets of the ranges scan would have assigned.
+    //
+    // Up to an "@", the characters of an authority may be either userinfo
+    // or host and port; the parser follows both, and does not fail until
+    // neither can continue.
+    //
+    class push_parser {
+    public:
+        enum status {
+            partial,
+            complete,
+            failed
+        };
+
+        enum component {
+            scheme_component,
+            userinfo_component,
+            host_component,
+            port_component,
+            path_component,
+            query_component,
+            fragment_component
+        };
+
+    private:
+        enum state_type {
+            start_state,
+            scheme_state,
+            after_scheme_state,
+            slash_state,
+            segment_state,
+            path_state,
+            authority_state,
+            query_state,
+            fragment_state
+        };
+
+        enum host_state_type {
+            host_start,
+            host_reg_name,
+            host_ip_literal,
+            host_ipv6,
+            host_ipvfuture,
+            host_ipvfuture_hex,
+            host_ipvfuture_dot,
+            host_ipvfuture_chars,
+            host_after,
+            host_port,
+            host_dead
+        };
+
+        enum host_status {
+            host_continue,
+            host_end,
+            host_fail
+        };
+
+        status status_;
+        state_type state_;
+        std::uint32_t pos_;
+
+        //
+        // The number of hex digits still expected for a pct-encoded
+        // triple.
+        //
+        unsigned char pct_;
+
+        offset_components result_;
+
+        //
+        // Authority state.  userinfo_ is set while the characters since
+        // the start of the authority may still be userinfo.
+        //
+        bool userinfo_;
+        component authority_component_;
+        host_state_type host_state_;
+        std::uint32_t host_begin_, host_end_, port_begin_;
+        host_address address_;
+        detail::ipv4_matcher ipv4_;
+        char ip_literal_[48];
+        unsigned char ip_literal_length_;
+
+    public:
+        push_parser()
+        {
+            this->reset();
+        }
+
+        //
+        // Start over with a new URI.
+        //
+        void reset();
+
+        //
+        // Parse the next chunk of the URI.  Returns failed if a character
+        // in it cannot continue a URI-reference; offset then gives its
+        // position.  Once the parser has failed or finished, feed does
+        // nothing until it is reset.
+        //
+        status feed(const char * first, const char * last);
+
+        //
+        // Mark the end of the URI.  Returns complete if the input fed is a
+        // URI-reference in its entirety.
+        //
+        status finish();
+
+        status state() const { return this->status_; }
+
+        //
+        // The number of characters consumed; on failure, the offset of
+        // the character that was rejected.
+        //
+        std::uint32_t offset() const { return this->pos_; }
+
+        const offset_components & result() const { return this->result_; }
+
+        //
+        // The component that the last character consumed is part of, or
+        // on failure, the one the rejected character was to continue.
+        // Characters before the ":" of a scheme are taken as scheme until
+        // one turns out not to be, and that one as path.  In an authority
+        // before any "@", a character that only userinfo could take is
+        // userinfo; otherwise it is host or port.
+        //
+        component current_component() const;
+
+    private:
+        static offset_range make_range(const std::uint32_t begin,
+                                       const std::uint32_t end)
+        {
+            const offset_range r = { begin, end - begin };
+            return r;
+        }
+
+        void close(offset_range & r) const
+        {
+            r.length = this->pos_ - r.begin;
+        }
+
+        //
+        // A character of chars or the start of a pct-encoded triple.
+        //
+        bool pct_char(const char c, const unsigned short chars)
+        {
+            if (detail::char_classes(c) & chars) { return true; }
+            if (c != '%') { return false; }
+            this->pct_ = 2;
+            return true;
+        }
+
+        bool step(char c);
+        bool after_path(char c);
+        void start_authority(std::uint32_t begin);
+        bool authority_step(char c);
+        host_status host_step(char c);
+        bool end_reg_name();
+        bool end_host();
+        void close_authority();
+    };
+
+    inline void push_parser::reset()
+    {
+        this->status_ = partial;
+        this->state_ = start_state;
+        this->pos_ = 0;
+        this->pct_ = 0;
+        this->result_ = offset_components();
+    }
+
+    inline push_parser::status push_parser::feed(const char * first,
+                                                 const char * const last)
+    {
+        if (this->status_ != partial) { return this->status_; }
+        for (; first != last; ++first) {
+            if (this->pos_ == offset_range::absent - 1
+                || !this->step(*first)) {
+                return this->status_ = failed;
+            }
+            ++this->pos_;
+        }
+        return partial;
+    }
+
+    inline push_parser::status push_parser::finish()
+    {
+        if (this->status_ != partial) { return this->status_; }
+        if (this->pct_ > 0) { return this->status_ = failed; }
+
+        switch (this->state_) {
+        case start_state:
+            this->result_.scheme = make_range(0, 0);
+            this->result_.path = make_range(0, 0);
+            break;
+        case scheme_state:
+            this->result_.path = make_range(0, this->pos_);
+            break;
+        case after_scheme_state:
+            this->result_.path = make_range(this->pos_, this->pos_);
+            break;
+        case slash_state:
+        case segment_state:
+        case path_state:
+            this->close(this->result_.path);
+            break;
+        case authority_state:
+            if (!this->end_host()) { return this->status_ = failed; }
+            this->close_authority();
+            this->result_.path = make_range(this->pos_, this->pos_);
+            break;
+        case query_state:
+            this->close(this->result_.query);
+            break;
+        case fragment_state:
+            this->close(this->result_.fragment);
+            break;
+        }
+        return this->status_ = complete;
+    }
+
+    inline push_parser::component push_parser::current_component() const
+    {
+        switch (this->state_) {
+        case scheme_state:
+        case after_scheme_state:
+            return scheme_component;
+        case authority_state:
+            return this->authority_component_;
+        case query_state:
+            return query_component;
+        case fragment_state:
+            return fragment_component;
+        default:
+            return path_component;
+        }
+    }
+
+    inline bool push_parser::step(const char c)
+    {
+        using namespace detail;
+
+        if (this->pct_ > 0) {
+            if (hex_value(c) > 0xf) { return false; }
+            --this->pct_;
+            return true;
+        }
+
+        switch (this->state_) {
+        case start_state:
+            this->result_.scheme = make_range(0, 0);
+            this->result_.path = make_range(0, 0);
+            if (char_classes(c) & alpha_class) {
+                this->state_ = scheme_state;
+                return true;
+            }
+            if (c == '/') {
+                this->state_ = slash_state;
+                return true;
+            }
+            if (this->pct_char(c, segment_nz_nc_chars)) {
+                this->state_ = segment_state;
+                return true;
+            }
+            return this->after_path(c);
+
+        case scheme_state:
+            if (char_classes(c) & scheme_class) { return true; }
+            if (c == ':') {
+                this->result_.scheme = make_range(0, this->pos_);
+                this->state_ = after_scheme_state;
+                return true;
+            }
+            //
+            // Not a scheme after all, but the first segment of a
+            // relative-ref.
+            //
+            this->state_ = segment_state;
+            return this->step(c);
+
+        case after_scheme_state:
+            this->result_.path = make_range(this->pos_, this->pos_);
+            if (c == '/') {
+                this->state_ = slash_state;
+                return true;
+            }
+            this->state_ = path_state;
+            return this->step(c);
+
+        case slash_state:
+            if (c == '/') {
+                this->start_authority(this->pos_ + 1);
+                return true;
+            }
+            this->state_ = path_state;
+            return this->step(c);
+
+        case segment_state:
+            if (this->pct_char(c, segment_nz_nc_chars)) { return true; }
+            if (c == '/') {
+                this->state_ = path_state;
+                return true;
+            }
+            return this->after_path(c);
+
+        case path_state:
+            if (this->pct_char(c, path_chars)) { return true; }
+            return this->after_path(c);
+
+        case authority_state:
+            return this->authority_step(c);
+
+        case query_state:
+            if (this->pct_char(c, query_chars)) { return true; }
+            if (c != '#') { return false; }
+            this->close(this->result_.query);
+            this->result_.fragment = make_range(this->pos_ + 1, this->pos_ + 1);
+            this->state_ = fragment_state;
+            return true;
+
+        case fragment_state:
+            return this->pct_char(c, query_chars);
+        }
+        return false;
+    }
+
+    //
+    // End the path at c, which must then start the query or the fragment.
+    //
+    inline bool push_parser::after_path(const char c)
+    {
+        if (c != '?' && c != '#') { return false; }
+        this->close(this->result_.path);
+        const offset_range next = make_range(this->pos_ + 1, this->pos_ + 1);
+        if (c == '?') {
+            this->result_.query = next;
+            this->state_ = query_state;
+        } else {
+            this->result_.fragment = next;
+            this->state_ = fragment_state;
+        }
+        return true;
+    }
+
+    inline void push_parser::start_authority(const std::uint32_t begin)
+    {
+        this->state_ = authority_state;
+        this->userinfo_ = true;
+        this->authority_component_ = host_component;
+        this->host_state_ = host_start;
+        this->host_begin_ = begin;
+        this->port_begin_ = offset_range::absent;
+        this->address_ = host_address();
+        this->ipv4_ = detail::ipv4_matcher();
+    }
+
+    inline bool push_parser::authority_step(const char c)
+    {
+        if (this->userinfo_ && c == '@') {
+            this->result_.userinfo = make_range(this->host_begin_, this->pos_);
+            const std::uint32_t host_begin = this->pos_ + 1;
+            this->start_authority(host_begin);
+            this->userinfo_ = false;
+            return true;
+        }
+
+        const bool userinfo = this->userinfo_
+            && (c == '%' || (detail::char_classes(c) & detail::userinfo_chars));
+        const host_state_type host_state = this->host_state_;
+        switch (this->host_step(c)) {
+        case host_end:
+            //
+            // c ends the authority; the path is path-abempty.
+            //
+            this->close_authority();
+            this->result_.path = make_range(this->pos_, this->pos_);
+            if (c == '/') {
+                this->state_ = path_state;
+                return true;
+            }
+            return this->after_path(c);
+        case host_fail:
+            if (!userinfo) {
+                this->authority_component_ =
+                    host_state == host_port ? port_component
+                    : host_state == host_dead ? userinfo_component
+                    : host_component;
+                return false;
+            }
+            this->authority_component_ = userinfo_component;
+            break;
+        case host_continue:
+            this->authority_component_ = this->host_state_ == host_port
+                ? port_component
+                : host_component;
+            break;
+        }
+        this->userinfo_ = userinfo;
+        if (c == '%') { this->pct_ = 2; }
+        return true;
+    }
+
+    inline push_parser::host_status push_parser::host_step(const char c)
+    {
+        using namespace detail;
+
+        const unsigned short classes = char_classes(c);
+        switch (this->host_state_) {
+        case host_start:
+            if (c == '[') {
+                this->ip_literal_[0] = c;
+                this->ip_literal_length_ = 1;
+                this->host_state_ = host_ip_literal;
+                return host_continue;
+            }
+            this->host_state_ = host_reg_name;
+            // fall through
+        case host_reg_name:
+            if (c == '%' || (classes & reg_name_chars)) {
+                this->ipv4_.push(c);
+                return host_continue;
+            }
+            if (!this->end_reg_name()) { break; }
+            // fall through
+        case host_after:
+            if (c == ':') {
+                this->port_begin_ = this->pos_ + 1;
+                this->host_state_ = host_port;
+                return host_continue;
+            }
+            if (c == '/' || c == '?' || c == '#') { return host_end; }
+            break;
+
+        case host_port:
+            if (classes & digit_class) { return host_continue; }
+            if (c == '/' || c == '?' || c == '#') { return host_end; }
+            break;
+
+        case host_ip_literal:
+            if (c == 'v') {
+                this->host_state_ = host_ipvfuture;
+                return host_continue;
+            }
+            this->host_state_ = host_ipv6;
+            // fall through
+        case host_ipv6:
+            if (c == ']') {
+                this->ip_literal_[this->ip_literal_length_++] = c;
+                const char * const last =
+                    this->ip_literal_ + this->ip_literal_length_;
+                if (scan_ip_literal(static_cast<const char *>(this->ip_literal_),
+                                    last, this->address_) != last) {
+                    break;
+                }
+                this->host_end_ = this->pos_ + 1;
+                this->host_state_ = host_after;
+                return host_continue;
+            }
+            if (((classes & xdigit_class) || c == ':' || c == '.')
+                && this->ip_literal_length_ < sizeof this->ip_literal_ - 1) {
+                this->ip_literal_[this->ip_literal_length_++] = c;
+                return host_continue;
+            }
+            break;
+
+        case host_ipvfuture:
+            if (!(classes & xdigit_class)) { break; }
+            this->host_state_ = host_ipvfuture_hex;
+            return host_continue;
+
+        case host_ipvfuture_hex:
+            if (classes & xdigit_class) { return host_continue; }
+            if (c != '.') { break; }
+            this->host_state_ = host_ipvfuture_dot;
+            return host_continue;
+
+        case host_ipvfuture_dot:
+            if (!(classes & userinfo_chars)) { break; }
+            this->host_state_ = host_ipvfuture_chars;
+            return host_continue;
+
+        case host_ipvfuture_chars:
+            if (classes & userinfo_chars) { return host_continue; }
+            if (c != ']') { break; }
+            this->address_ = host_address(ipvfuture_host);
+            this->host_end_ = this->pos_ + 1;
+            this->host_state_ = host_after;
+            return host_continue;
+
+        case host_dead:
+            break;
+        }
+        this->host_state_ = host_dead;
+        return host_fail;
+    }
+
+    //
+    // Choose between IPv4address and reg-name for the host that ends
+    // here, as host_grammar does.  Fails if IPv4address matches only part
+    // of it, since nothing could then follow the address.
+    //
+    inline bool push_parser::end_reg_name()
+    {
+        std::uint32_t ipv4 = 0;
+        switch (this->ipv4_.finish(ipv4)) {
+        case detail::ipv4_matcher::match:
+            this->address_ = host_address(ipv4);
+            break;
+        case detail::ipv4_matcher::no_match:
+            this->address_ = host_address();
+            break;
+        case detail::ipv4_matcher::prefix_match:
+            return false;
+        }
+        this->host_end_ = this->pos_;
+        this->host_state_ = host_after;
+        return true;
+    }
+
+    //
+    // End the host (and port) at the end of the input.
+    //
+    inline bool push_parser::end_host()
+    {
+        switch (this->host_state_) {
+        case host_start:
+        case host_reg_name:
+            return this->end_reg_name();
+        case host_after:
+        case host_port:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    inline void push_parser::close_authority()
+    {
+        this->result_.host = make_range(this->host_begin_, this->host_end_);
+        this->result_.address = this->address_;
+        if (this->port_begin_ != offset_range::absent) {
+            this->result_.port = make_range(this->port_begin_, this->pos_);
+        }
+    }
+
+    //
+    // Where is_uri_reference stopped: the offset of the first character
+    // that cannot continue a URI-reference (or of the end of the input,
+    // if that comes too soon) and the component it was in.
+    //
+    struct rejection {
+        std::uint32_t offset;
+        push_parser::component component;
+    };
+
+    //
+    // Whether [first, last) is a URI-reference in its entirety.  Unlike
+    // parsing with grammar (and checking that it matched everything), this
+    // makes one pass with no backtracking and stops at the first character
+    // that no URI-reference could continue with; if there is one, r says
+    // where it is.  Time is linear in the length of the input, whatever
+    // the input.
+    //
+    inline bool is_uri_reference(const char * const first,
+                                 const char * const last,
+                                 rejection & r)
+    {
+        push_parser parser;
+        if (parser.feed(first, last) == push_parser::partial
+            && parser.finish() == push_parser::complete) {
+            return true;
+        }
+        r.offset = parser.offset();
+        r.component = parser.current_component();
+        return false;
+    }
+} // namespace uri
+
+# endif // ifndef URI_PUSH_PARSER_HPP
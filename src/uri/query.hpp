@@ -0,0 +1,181 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_QUERY_HPP
+#   define URI_QUERY_HPP
+
+#   include <uri/detail/simd.hpp>
+#   include <uri/pct_decode.hpp>
+#   include <boost/range/algorithm/equal.hpp>
+#   include <boost/range/as_literal.hpp>
+
+namespace uri {
+
+    //
+    // A key/value pair of a query, as ranges of the query itself.  value
+    // is empty (and begins at the end of key) if there is no "=".
+    //
+    template <typename Iterator>
+    struct query_parameter {
+        boost::iterator_range<Iterator> key, value;
+    };
+
+    namespace detail {
+
+        //
+        // The first "&" or ";" in [first, last), or the first "=" as well
+        // if equals is set.
+        //
+        template <typename Iterator>
+        Iterator find_query_delimiter(Iterator first, const Iterator last,
+                                      const bool equals)
+        {
+            for (; first != last; ++first) {
+                const char c = *first;
+                if (c == '&' || c == ';' || (equals && c == '=')) { break; }
+            }
+            return first;
+        }
+
+        //
+        // Contiguous input is searched a block at a time.  Without equals,
+        // the "=" comparison is made against "&" again.
+        //
+        struct query_delimiter_test {
+            static const std::size_t lookahead = 0;
+
+            char third;
+
+            explicit query_delimiter_test(const bool equals):
+                third(equals ? '=' : '&')
+            {}
+
+            template <typename Block>
+            unsigned block(const char * const p) const
+            {
+                const Block v(p);
+                return v.eq('&') | v.eq(';') | v.eq(this->third);
+            }
+
+            bool at(const char * const p) const
+            {
+                return *p == '&' || *p == ';' || *p == this->third;
+            }
+        };
+
+        inline const char * find_query_delimiter(const char * const first,
+                                                 const char * const last,
+                                                 const bool equals)
+        {
+            return find_first(first, last, query_delimiter_test(equals));
+        }
+    }
+
+
+    //
+    // Iterates over the parameters of a query, separated by "&" or ";",
+    // finding each one only when it is reached.  Empty parameters are
+    // skipped.  Nothing is copied or allocated; keys and values are
+    // ranges of the query, still encoded (see pct_decoded).
+    //
+    template <typename Iterator>
+    class query_iterator :
+        public boost::iterator_facade<query_iterator<Iterator>,
+                                      const query_parameter<Iterator>,
+                                      boost::forward_traversal_tag> {
+        friend class boost::iterator_core_access;
+
+        Iterator next_, last_;
+        query_parameter<Iterator> parameter_;
+
+    public:
+        query_iterator() {}
+
+        query_iterator(const Iterator first, const Iterator last):
+            next_(first),
+            last_(last)
+        {
+            this->load();
+        }
+
+    private:
+        void load()
+        {
+            Iterator first = this->next_;
+            while (first != this->last_ && (*first == '&' || *first == ';')) {
+                ++first;
+            }
+
+            Iterator i = detail::find_query_delimiter(first, this->last_, true);
+            this->parameter_.key = boost::make_iterator_range(first, i);
+            Iterator value = i;
+            if (i != this->last_ && *i == '=') {
+                value = ++i;
+                i = detail::find_query_delimiter(i, this->last_, false);
+            }
+            this->parameter_.value = boost::make_iterator_range(value, i);
+            this->next_ = i;
+        }
+
+        const query_parameter<Iterator> & dereference() const
+        {
+            return this->parameter_;
+        }
+
+        void increment()
+        {
+            this->load();
+        }
+
+        bool equal(const query_iterator & other) const
+        {
+            return this->parameter_.key.begin()
+                == other.parameter_.key.begin();
+        }
+    };
+
+    //
+    // The parameters of query, typically the query of a components.
+    //
+    template <typename Iterator>
+    boost::iterator_range<query_iterator<Iterator> >
+    query_parameters(const boost::iterator_range<Iterator> & query)
+    {
+        typedef query_iterator<Iterator> iterator;
+        return boost::make_iterator_range(
+            iterator(query.begin(), query.end()),
+            iterator(query.end(), query.end()));
+    }
+
+    //
+    // The first parameter of query whose decoded key is key, or the end
+    // of query_parameters(query).  The query is scanned only as far as
+    // that parameter.
+    //
+    template <typename Iterator, typename Key>
+    query_iterator<Iterator>
+    find_parameter(const boost::iterator_range<Iterator> & query,
+                   const Key & key)
+    {
+        const boost::iterator_range<query_iterator<Iterator> > parameters =
+            query_parameters(query);
+        query_iterator<Iterator> i = parameters.begin();
+        for (; i != parameters.end(); ++i) {
+            if (boost::equal(pct_decoded(i->key), boost::as_literal(key))) {
+                break;
+            }
+        }
+        return i;
+    }
+} // namespace uri
+
+# endif // ifndef URI_QUERY_HPP
@@ -0,0 +1,399 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_RESOLVE_HPP
+#   define URI_RESOLVE_HPP
+
+#   include <uri/batch.hpp>
+#   include <uri/normalize.hpp>
+#   include <iterator>
+#   include <string>
+#   include <utility>
+
+namespace uri {
+
+    namespace detail {
+
+        struct copy_length_visitor {
+            std::size_t length;
+
+            copy_length_visitor(): length(0) {}
+
+            template <typename Iterator>
+            void segment(const Iterator first, const Iterator last)
+            {
+                this->length += std::distance(first, last);
+            }
+
+            void changed() {}
+        };
+
+        //
+        // Copies segments backward from end.
+        //
+        struct copy_write_visitor {
+            char * end;
+
+            explicit copy_write_visitor(char * const end): end(end) {}
+
+            template <typename Iterator>
+            void segment(const Iterator first, const Iterator last)
+            {
+                this->end -= std::distance(first, last);
+                std::copy(first, last, this->end);
+            }
+
+            void changed() {}
+        };
+
+        struct segment_collector {
+            std::vector<std::pair<const char *, const char *> > segments;
+
+            void segment(const char * const first, const char * const last)
+            {
+                this->segments.push_back(std::make_pair(first, last));
+            }
+
+            void changed() {}
+        };
+
+        template <typename Iterator, typename Sink>
+        void put_range(Iterator first, const Iterator last, Sink & sink)
+        {
+            for (; first != last; ++first) { sink.put(*first); }
+        }
+
+        //
+        // The authority of c, "//" excluded, or an empty range if it has
+        // none.
+        //
+        template <typename Iterator>
+        boost::iterator_range<Iterator>
+        authority_range(const components<Iterator> & c)
+        {
+            if (!(c.present & host_present)) {
+                return boost::iterator_range<Iterator>();
+            }
+            return boost::make_iterator_range(
+                (c.present & userinfo_present) ? c.userinfo.begin()
+                                               : c.host.begin(),
+                (c.present & port_present) ? c.port.end() : c.host.end());
+        }
+    }
+
+
+    //
+    // A base URI for reference resolution (RFC 3986, section 5.2), parsed
+    // once and then used for any number of references.
+    //
+    // Besides the offsets of its components, the base keeps its path up
+    // to the last "/" with dot-segments already removed, along with the
+    // end of each remaining segment.  Merging a reference's path with it
+    // then comes down to walking the reference path backward, as
+    // normalize does, and copying as much of that prefix as the
+    // reference's ".." segments leave.
+    //
+    // The resolution is strict: references with the same scheme as the
+    // base are not treated as relative.
+    //
+    class base_uri {
+        std::string text_;
+        offset_range scheme_, authority_, path_, query_;
+
+        std::string head_;
+        std::vector<std::uint32_t> head_ends_;
+
+        //
+        // Whether a merged path is the reference path alone: the base path
+        // has no "/", or all that precedes its last one is removed by
+        // rule A or D of remove_dot_segments.
+        //
+        bool merge_bare_;
+
+    public:
+        //
+        // Throws std::invalid_argument if text is not an absolute URI.
+        // A fragment, if any, is ignored.
+        //
+        explicit base_uri(const std::string & text);
+
+        const std::string & text() const { return this->text_; }
+
+        //
+        // The length of the target of the reference r.  r must have been
+        // default-constructed before it was filled in by a grammar (or the
+        // scanner), so that its present bits are those of the components
+        // it has; and Iterator must be bidirectional.
+        //
+        template <typename Iterator>
+        std::size_t resolved_length(const components<Iterator> & r) const
+        {
+            detail::length_sink sink;
+            this->put_target(r, sink);
+            return sink.length;
+        }
+
+        //
+        // Write the target of r to out, which must have room for
+        // resolved_length(r) characters.  Returns the end of the output.
+        //
+        template <typename Iterator>
+        char * resolve(const components<Iterator> & r, char * const out) const
+        {
+            detail::write_sink sink(out);
+            this->put_target(r, sink);
+            return sink.out;
+        }
+
+        //
+        // Resolve each of the references in [first, last), a range of
+        // components<Iterator>, appending the targets to arena and their
+        // positions in it to targets.  arena grows once, by the total
+        // length of the targets; nothing is allocated per reference.
+        //
+        template <typename InputIterator>
+        void resolve(InputIterator first, const InputIterator last,
+                     std::string & arena,
+                     std::vector<offset_range> & targets) const
+        {
+            std::size_t length = arena.size(), count = 0;
+            for (InputIterator r = first; r != last; ++r, ++count) {
+                length += this->resolved_length(*r);
+            }
+            if (length > std::numeric_limits<std::uint32_t>::max()) {
+                throw std::length_error("uri: resolution arena exceeds the "
+                                        "range of 32-bit offsets");
+            }
+
+            std::size_t pos = arena.size();
+            arena.resize(length);
+            targets.reserve(targets.size() + count);
+            for (InputIterator r = first; r != last; ++r) {
+                char * const begin = &arena[0] + pos;
+                char * const end = this->resolve(*r, begin);
+                const offset_range target = {
+                    std::uint32_t(pos), std::uint32_t(end - begin)
+                };
+                targets.push_back(target);
+                pos += end - begin;
+            }
+        }
+
+    private:
+        boost::iterator_range<const char *>
+        range(const offset_range & r) const
+        {
+            const char * const begin = this->text_.data() + r.begin;
+            return boost::make_iterator_range(begin, begin + r.length);
+        }
+
+        //
+        // Visit the segments of the target path backward.
+        //
+        template <typename Iterator, typename Visitor>
+        void reverse_target_path(const components<Iterator> & r,
+                                 Visitor & visitor) const;
+
+        template <typename Iterator, typename Sink>
+        void put_target(const components<Iterator> & r, Sink & sink) const;
+
+        template <typename Iterator>
+        void put_path(const components<Iterator> & r,
+                      detail::length_sink & sink) const
+        {
+            detail::copy_length_visitor path;
+            this->reverse_target_path(r, path);
+            sink.length += path.length;
+        }
+
+        template <typename Iterator>
+        void put_path(const components<Iterator> & r,
+                      detail::write_sink & sink) const
+        {
+            detail::copy_length_visitor length;
+            this->reverse_target_path(r, length);
+            sink.out += length.length;
+            detail::copy_write_visitor path(sink.out);
+            this->reverse_target_path(r, path);
+        }
+    };
+
+    inline base_uri::base_uri(const std::string & text):
+        text_(text),
+        merge_bare_(false)
+    {
+        const char * const base = this->text_.data();
+        const char * first = base;
+        const char * const last = base + this->text_.size();
+        components<const char *> c;
+        scan(first, last, c);
+        if (first != last || c.scheme.empty()) {
+            throw std::invalid_argument("uri: base is not an absolute URI");
+        }
+
+        this->scheme_ = detail::make_offset_range(base, c.scheme, true);
+        this->authority_ =
+            detail::make_offset_range(base, detail::authority_range(c),
+                                      c.present & host_present);
+        this->path_ = detail::make_offset_range(base, c.path, true);
+        this->query_ = detail::make_offset_range(base, c.query,
+                                                 c.present & query_present);
+
+        //
+        // RFC 3986, section 5.2.3.  With an authority and an empty path,
+        // the merged path is "/" followed by the reference path; that is
+        // what an empty head gives.
+        //
+        if (this->authority_.present() && c.path.empty()) { return; }
+
+        const char * slash = c.path.end();
+        while (slash != c.path.begin() && *(slash - 1) != '/') { --slash; }
+        if (slash == c.path.begin()) {
+            this->merge_bare_ = true;
+            return;
+        }
+        --slash;
+
+        //
+        // Rules A and D may take the "/" after the head along with it;
+        // then nothing of the base path is left.
+        //
+        detail::segment_collector head;
+        const char * const head_first =
+            detail::skip_leading_dot_segments(c.path.begin(), slash + 1,
+                                              false, head);
+        if (head_first == slash + 1) {
+            this->merge_bare_ = true;
+            return;
+        }
+
+        //
+        // The head is followed by "/" and the reference path, so its own
+        // final "." or ".." leaves no "/".
+        //
+        const char * rest = head_first;
+        while (rest != slash && *rest != '/') { ++rest; }
+        const std::size_t skip =
+            detail::reverse_slash_segments(rest, slash, false, false, head);
+        if (head_first != rest && skip == 0) { head.segment(head_first, rest); }
+
+        for (std::size_t i = head.segments.size(); i > 0; --i) {
+            this->head_.append(head.segments[i - 1].first,
+                               head.segments[i - 1].second);
+            this->head_ends_.push_back(std::uint32_t(this->head_.size()));
+        }
+    }
+
+    template <typename Iterator, typename Visitor>
+    void base_uri::reverse_target_path(const components<Iterator> & r,
+                                       Visitor & visitor) const
+    {
+        const Iterator first = r.path.begin(), last = r.path.end();
+        if (!r.scheme.empty() || (r.present & host_present)
+            || (first != last && *first == '/')) {
+            detail::reverse_remove_dot_segments(first, last, false, visitor);
+            return;
+        }
+        if (first == last) {
+            const boost::iterator_range<const char *> path =
+                this->range(this->path_);
+            visitor.segment(path.begin(), path.end());
+            return;
+        }
+        if (this->merge_bare_) {
+            detail::reverse_remove_dot_segments(first, last, false, visitor);
+            return;
+        }
+
+        //
+        // The merged path is head_, "/", and the reference path.  The
+        // reference path's first segment gets the "/" in between.
+        //
+        Iterator rest = first;
+        while (rest != last && *rest != '/') { ++rest; }
+        std::size_t skip =
+            detail::reverse_slash_segments(rest, last, true, false, visitor);
+
+        static const char slash = '/';
+        const int dots = detail::dot_segment(first, rest, false);
+        if (dots == 0) {
+            if (skip > 0) {
+                --skip;
+            } else {
+                visitor.segment(first, rest);
+                visitor.segment(&slash, &slash + 1);
+            }
+        } else {
+            if (rest == last) { visitor.segment(&slash, &slash + 1); }
+            if (dots == 2) { ++skip; }
+        }
+
+        const std::size_t n = this->head_ends_.size();
+        if (skip < n) {
+            visitor.segment(this->head_.data(),
+                            this->head_.data() + this->head_ends_[n - skip - 1]);
+        }
+    }
+
+    template <typename Iterator, typename Sink>
+    void base_uri::put_target(const components<Iterator> & r,
+                              Sink & sink) const
+    {
+        const bool own_authority =
+            !r.scheme.empty() || (r.present & host_present);
+
+        const boost::iterator_range<const char *> base_scheme =
+            this->range(this->scheme_);
+        if (!r.scheme.empty()) {
+            detail::put_range(r.scheme.begin(), r.scheme.end(), sink);
+        } else {
+            detail::put_range(base_scheme.begin(), base_scheme.end(), sink);
+        }
+        sink.put(':');
+
+        if (own_authority) {
+            if (r.present & host_present) {
+                const boost::iterator_range<Iterator> authority =
+                    detail::authority_range(r);
+                sink.put('/');
+                sink.put('/');
+                detail::put_range(authority.begin(), authority.end(), sink);
+            }
+        } else if (this->authority_.present()) {
+            const boost::iterator_range<const char *> authority =
+                this->range(this->authority_);
+            sink.put('/');
+            sink.put('/');
+            detail::put_range(authority.begin(), authority.end(), sink);
+        }
+
+        this->put_path(r, sink);
+
+        if (r.present & query_present) {
+            sink.put('?');
+            detail::put_range(r.query.begin(), r.query.end(), sink);
+        } else if (!own_authority && r.path.empty()
+                   && this->query_.present()) {
+            const boost::iterator_range<const char *> query =
+                this->range(this->query_);
+            sink.put('?');
+            detail::put_range(query.begin(), query.end(), sink);
+        }
+
+        if (r.present & fragment_present) {
+            sink.put('#');
+            detail::put_range(r.fragment.begin(), r.fragment.end(), sink);
+        }
+    }
+} // namespace uri
+
+# endif // ifndef URI_RESOLVE_HPP
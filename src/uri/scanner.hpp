@@ -0,0 +1,244 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_SCANNER_HPP
+#   define URI_SCANNER_HPP
+
+#   include <uri/char_class.hpp>
+#   include <uri/grammar.hpp>
+
+namespace uri {
+
+    namespace detail {
+
+        //
+        // authority_grammar's dec_octet alternatives, tried in the same
+        // order.  Returns first if no alternative matches.
+        //
+        template <typename Iterator>
+        Iterator scan_dec_octet(const Iterator first, const Iterator last,
+                                std::uint32_t & value)
+        {
+            char d[3] = { 0, 0, 0 };
+            Iterator i = first;
+            for (int n = 0; n < 3 && i != last; ++n, ++i) { d[n] = *i; }
+
+            const bool digit1 = d[1] >= '0' && d[1] <= '9';
+            const bool digit2 = d[2] >= '0' && d[2] <= '9';
+            std::size_t len = 0;
+            if (d[0] == '2' && d[1] == '5' && d[2] >= '0' && d[2] <= '5') {
+                len = 3;
+            } else if (d[0] == '2' && d[1] >= '0' && d[1] <= '4' && digit2) {
+                len = 3;
+            } else if (d[0] == '1' && digit1 && digit2) {
+                len = 3;
+            } else if (d[0] >= '1' && d[0] <= '9' && digit1) {
+                len = 2;
+            } else if (d[0] >= '0' && d[0] <= '9') {
+                len = 1;
+            }
+
+            value = 0;
+            for (std::size_t n = 0; n < len; ++n) {
+                value = value * 10 + (d[n] - '0');
+            }
+
+            i = first;
+            std::advance(i, len);
+            return i;
+        }
+
+        template <typename Iterator>
+        Iterator scan_ipv4address(const Iterator first, const Iterator last,
+                                  std::uint32_t & address)
+        {
+            Iterator i = first;
+            address = 0;
+            for (int octet = 0; octet < 4; ++octet) {
+                if (octet > 0) {
+                    if (i == last || *i != '.') { return first; }
+                    ++i;
+                }
+                std::uint32_t value;
+                const Iterator octet_end = scan_dec_octet(i, last, value);
+                if (octet_end == i) { return first; }
+                address = (address << 8) | value;
+                i = octet_end;
+            }
+            return i;
+        }
+
+        //
+        // IP-literals are rare enough that they are handed off to
+        // host_grammar's ip_literal rule.  That rule's actions write only
+        // to its own attribute, so a single instance can be shared.
+        //
+        template <typename Iterator>
+        Iterator scan_ip_literal(const Iterator first, const Iterator last,
+                                 host_address & address)
+        {
+            static const host_grammar<Iterator> g;
+            Iterator i = first;
+            if (boost::spirit::qi::parse(i, last, g.ip_literal, address)) {
+                return i;
+            }
+            address = host_address();
+            return first;
+        }
+
+        template <typename Iterator>
+        Iterator scan_authority(Iterator first, const Iterator last,
+                                components<Iterator> & c)
+        {
+            Iterator i = scan_pct_chars(first, last, userinfo_chars);
+            if (i != last && *i == '@') {
+                c.userinfo = boost::make_iterator_range(first, i);
+                c.present |= userinfo_present;
+                first = ++i;
+            }
+
+            Iterator host_end = first;
+            c.address = host_address();
+            if (first != last && *first == '[') {
+                host_end = scan_ip_literal(first, last, c.address);
+            } else {
+                std::uint32_t ipv4;
+                host_end = scan_ipv4address(first, last, ipv4);
+                if (host_end != first) {
+                    c.address = host_address(ipv4);
+                } else {
+                    host_end = scan_pct_chars(first, last, reg_name_chars);
+                }
+            }
+            c.host = boost::make_iterator_range(first, host_end);
+            c.present |= host_present;
+            first = host_end;
+
+            if (first != last && *first == ':') {
+                ++first;
+                i = scan_chars(first, last, digit_class);
+                c.port = boost::make_iterator_range(first, i);
+                c.present |= port_present;
+                first = i;
+            }
+            return first;
+        }
+
+        template <typename Iterator>
+        bool starts_with_slashes(Iterator first, const Iterator last)
+        {
+            return first != last && *first == '/'
+                && ++first != last && *first == '/';
+        }
+
+        template <typename Iterator>
+        Iterator scan_path_abempty(const Iterator first, const Iterator last)
+        {
+            return (first != last && *first == '/')
+                ? scan_pct_chars(first, last, path_chars)
+                : first;
+        }
+
+        template <typename Iterator>
+        Iterator scan_query_fragment(Iterator first, const Iterator last,
+                                     components<Iterator> & c)
+        {
+            Iterator i;
+            if (first != last && *first == '?') {
+                i = scan_pct_chars(++first, last, query_chars);
+                c.query = boost::make_iterator_range(first, i);
+                c.present |= query_present;
+                first = i;
+            }
+            if (first != last && *first == '#') {
+                i = scan_pct_chars(++first, last, query_chars);
+                c.fragment = boost::make_iterator_range(first, i);
+                c.present |= fragment_present;
+                first = i;
+            }
+            return first;
+        }
+    }
+
+    //
+    // Single-pass equivalent of qi::parse(first, last, grammar<Iterator>(c)).
+    //
+    // Characters are classified by table lookup rather than through the
+    // rule tree; only IP-literals are delegated to Spirit.  On return,
+    // first points past the matched prefix and c holds the same ranges
+    // grammar<Iterator> would have assigned, with their bits set in
+    // c.present.  Components the grammar would not touch (e.g., query
+    // when there is no "?") are left as is.
+    //
+    template <typename Iterator>
+    bool scan(Iterator & first, const Iterator last, components<Iterator> & c)
+    {
+        using namespace detail;
+
+        Iterator i = first;
+
+        //
+        // URI: scheme ":" hier-part [ "?" query ] [ "#" fragment ]
+        //
+        if (i != last && (char_classes(*i) & alpha_class)) {
+            i = scan_chars(++i, last, scheme_class);
+            if (i != last && *i == ':') {
+                c.scheme = boost::make_iterator_range(first, i);
+                c.present |= scheme_present | path_present;
+                ++i;
+                if (starts_with_slashes(i, last)) {
+                    std::advance(i, 2);
+                    i = scan_authority(i, last, c);
+                    const Iterator path_end = scan_path_abempty(i, last);
+                    c.path = boost::make_iterator_range(i, path_end);
+                    i = path_end;
+                } else {
+                    const Iterator path_end =
+                        scan_pct_chars(i, last, path_chars);
+                    c.path = boost::make_iterator_range(i, path_end);
+                    i = path_end;
+                }
+                first = scan_query_fragment(i, last, c);
+                return true;
+            }
+            i = first;
+        }
+
+        //
+        // relative-ref: relative-part [ "?" query ] [ "#" fragment ]
+        //
+        c.scheme = boost::make_iterator_range(i, i);
+        c.present |= scheme_present | path_present;
+        if (starts_with_slashes(i, last)) {
+            std::advance(i, 2);
+            i = scan_authority(i, last, c);
+            const Iterator path_end = scan_path_abempty(i, last);
+            c.path = boost::make_iterator_range(i, path_end);
+            i = path_end;
+        } else if (i != last && *i == '/') {
+            const Iterator path_end = scan_pct_chars(i, last, path_chars);
+            c.path = boost::make_iterator_range(i, path_end);
+            i = path_end;
+        } else {
+            Iterator path_end = scan_pct_chars(i, last, segment_nz_nc_chars);
+            if (path_end != i && path_end != last && *path_end == '/') {
+                path_end = scan_pct_chars(path_end, last, path_chars);
+            }
+            c.path = boost::make_iterator_range(i, path_end);
+            i = path_end;
+        }
+        first = scan_query_fragment(i, last, c);
+        return true;
+    }
+} // namespace uri
+
+# endif // ifndef URI_SCANNER_HPP
@@ -0,0 +1,307 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_SCHEME_PROFILE_HPP
+#   define URI_SCHEME_PROFILE_HPP
+
+#   include <uri/normalize.hpp>
+#   include <uri/scanner.hpp>
+#   include <cstring>
+#   include <vector>
+
+namespace uri {
+
+    //
+    // components, with what a scheme profile adds: the name of the
+    // profile that parsed the URI (null if it was parsed generically),
+    // the port as a number, and whether that is the default for the
+    // scheme.
+    //
+    // port_number is the value of port if it has one of at most 65535;
+    // if the port is absent or empty, it is the profile's default port.
+    // It is zero for a port out of range, or no port without a profile.
+    //
+    template <typename Iterator>
+    struct profiled_components : components<Iterator> {
+        const char * profile;
+        std::uint32_t port_number;
+        bool default_port;
+
+        profiled_components():
+            profile(0),
+            port_number(0),
+            default_port(false)
+        {}
+    };
+
+    //
+    // A scheme that requires an authority ("//" after the colon), and the
+    // port that it implies when there is none.  scheme is lower case and
+    // matched without regard to case.
+    //
+    struct scheme_profile {
+        const char * scheme;
+        std::uint16_t default_port;
+    };
+
+    namespace detail {
+
+        //
+        // Matches "scheme:" at the start of the input.  Contiguous input
+        // with at least eight characters left is compared a word at a time
+        // for schemes of up to seven characters; case is folded by setting
+        // bit 5 of the input where scheme has a letter (only the two cases
+        // of a letter fold to it).
+        //
+        class scheme_matcher {
+            const char * scheme_;
+            std::size_t length_;
+            std::uint64_t expected_, fold_, mask_;
+
+        public:
+            explicit scheme_matcher(const char * const scheme):
+                scheme_(scheme),
+                length_(std::strlen(scheme)),
+                expected_(0),
+                fold_(0),
+                mask_(0)
+            {
+                if (this->length_ > 7) { return; }
+                char expected[8] = {}, fold[8] = {}, mask[8] = {};
+                for (std::size_t n = 0; n < this->length_; ++n) {
+                    expected[n] = scheme[n];
+                    fold[n] = (char_classes(scheme[n]) & alpha_class)
+                        ? 0x20 : 0;
+                    mask[n] = char(0xff);
+                }
+                expected[this->length_] = ':';
+                mask[this->length_] = char(0xff);
+                std::memcpy(&this->expected_, expected, 8);
+                std::memcpy(&this->fold_, fold, 8);
+                std::memcpy(&this->mask_, mask, 8);
+            }
+
+            //
+            // The end of the scheme (the ":" after it) if the input starts
+            // with "scheme:"; otherwise first.
+            //
+            template <typename Iterator>
+            Iterator operator()(const Iterator first,
+                                const Iterator last) const
+            {
+                Iterator i = first;
+                for (const char * s = this->scheme_; *s; ++s, ++i) {
+                    if (i == last || to_lower(*i) != *s) { return first; }
+                }
+                return (i != last && *i == ':') ? i : first;
+            }
+
+            const char * operator()(const char * const first,
+                                    const char * const last) const
+            {
+                if (this->length_ > 7 || last - first < 8) {
+                    return this->operator()<const char *>(first, last);
+                }
+                std::uint64_t word;
+                std::memcpy(&word, first, 8);
+                return ((word | this->fold_) & this->mask_) == this->expected_
+                    ? first + this->length_
+                    : first;
+            }
+        };
+
+        //
+        // The value of a port of digits, or 0x10000 if it is greater than
+        // 65535.
+        //
+        template <typename Iterator>
+        std::uint32_t
+        port_value(const boost::iterator_range<Iterator> & port)
+        {
+            std::uint32_t value = 0;
+            for (Iterator i = port.begin(); i != port.end(); ++i) {
+                value = value * 10 + (*i - '0');
+                if (value > 0xffff) { return 0x10000; }
+            }
+            return value;
+        }
+
+        template <typename Iterator>
+        void set_port(profiled_components<Iterator> & c,
+                      const std::uint32_t default_port)
+        {
+            c.port_number = 0;
+            c.default_port = false;
+            if (!(c.present & port_present) || c.port.empty()) {
+                c.port_number = default_port;
+                c.default_port = default_port != 0;
+                return;
+            }
+            const std::uint32_t value = port_value(c.port);
+            if (value > 0xffff) { return; }
+            c.port_number = value;
+            c.default_port = default_port != 0 && value == default_port;
+        }
+
+        //
+        // The remainder of a URI whose scheme ends at scheme_end: scan's
+        // authority branch, taken without looking at the scheme again.
+        // Returns false, leaving everything as it was, if there is no
+        // authority.
+        //
+        template <typename Iterator>
+        bool scan_profiled(Iterator & first, const Iterator scheme_end,
+                           const Iterator last,
+                           const scheme_profile & profile,
+                           profiled_components<Iterator> & c)
+        {
+            Iterator i = scheme_end;
+            if (!starts_with_slashes(++i, last)) { return false; }
+            c.scheme = boost::make_iterator_range(first, scheme_end);
+            c.present |= scheme_present | path_present;
+            std::advance(i, 2);
+            i = scan_authority(i, last, c);
+            const Iterator path_end = scan_path_abempty(i, last);
+            c.path = boost::make_iterator_range(i, path_end);
+            first = scan_query_fragment(path_end, last, c);
+            c.profile = profile.scheme;
+            set_port(c, profile.default_port);
+            return true;
+        }
+
+        template <typename Iterator>
+        bool scan_generic(Iterator & first, const Iterator last,
+                          profiled_components<Iterator> & c)
+        {
+            const bool result = scan(first, last, c);
+            c.profile = 0;
+            set_port(c, 0);
+            return result;
+        }
+
+        template <typename... Profiles>
+        struct try_profiles;
+
+        template <>
+        struct try_profiles<> {
+            template <typename Iterator>
+            static bool scan(Iterator & first, const Iterator last,
+                             profiled_components<Iterator> & c)
+            {
+                return scan_generic(first, last, c);
+            }
+        };
+
+        template <typename Profile, typename... Profiles>
+        struct try_profiles<Profile, Profiles...> {
+            template <typename Iterator>
+            static bool scan(Iterator & first, const Iterator last,
+                             profiled_components<Iterator> & c)
+            {
+                static const scheme_profile profile = Profile::profile();
+                static const scheme_matcher match(profile.scheme);
+                const Iterator i = match(first, last);
+                if (i != first
+                    && scan_profiled(first, i, last, profile, c)) {
+                    return true;
+                }
+                return try_profiles<Profiles...>::scan(first, last, c);
+            }
+        };
+    }
+
+
+    struct http_profile {
+        static scheme_profile profile()
+        {
+            const scheme_profile p = { "http", 80 };
+            return p;
+        }
+    };
+
+    struct https_profile {
+        static scheme_profile profile()
+        {
+            const scheme_profile p = { "https", 443 };
+            return p;
+        }
+    };
+
+    //
+    // A set of profiles fixed at compile time: each type has a static
+    // member function profile() returning a scheme_profile.  parse is
+    // equivalent to scan, with the additions of profiled_components;
+    // a URI whose scheme has a profile but that has no authority, like
+    // any other, is scanned generically.
+    //
+    template <typename... Profiles>
+    struct scheme_profiles {
+        template <typename Iterator>
+        static bool parse(Iterator & first, const Iterator last,
+                          profiled_components<Iterator> & c)
+        {
+            return detail::try_profiles<Profiles...>::scan(first, last, c);
+        }
+    };
+
+    typedef scheme_profiles<http_profile, https_profile> web_profiles;
+
+    //
+    // A set of profiles chosen at run time, starting with http and https.
+    // The scheme strings must outlive the registry.  Profiles are tried
+    // in the order they were added; parse is not safe to call while
+    // another thread adds one.
+    //
+    class scheme_registry {
+        struct entry {
+            scheme_profile profile;
+            detail::scheme_matcher match;
+
+            explicit entry(const scheme_profile & profile):
+                profile(profile),
+                match(profile.scheme)
+            {}
+        };
+
+        std::vector<entry> profiles_;
+
+    public:
+        scheme_registry()
+        {
+            this->add(http_profile::profile());
+            this->add(https_profile::profile());
+        }
+
+        void add(const scheme_profile & profile)
+        {
+            this->profiles_.push_back(entry(profile));
+        }
+
+        template <typename Iterator>
+        bool parse(Iterator & first, const Iterator last,
+                   profiled_components<Iterator> & c) const
+        {
+            for (std::vector<entry>::const_iterator p =
+                     this->profiles_.begin();
+                 p != this->profiles_.end(); ++p) {
+                const Iterator i = p->match(first, last);
+                if (i != first
+                    && detail::scan_profiled(first, i, last, p->profile, c)) {
+                    return true;
+                }
+            }
+            return detail::scan_generic(first, last, c);
+        }
+    };
+} // namespace uri
+
+# endif // ifndef URI_SCHEME_PROFILE_HPP
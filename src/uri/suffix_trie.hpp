@@ -0,0 +1,390 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// uri_grammar
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+# ifndef URI_SUFFIX_TRIE_HPP
+#   define URI_SUFFIX_TRIE_HPP
+
+#   include <uri/batch.hpp>
+#   include <uri/normalize.hpp>
+#   include <algorithm>
+#   include <istream>
+#   include <iterator>
+#   include <map>
+#   include <stdexcept>
+#   include <string>
+#   include <vector>
+
+namespace uri {
+
+    //
+    // The result of matching a host against a suffix_trie.  suffix is the
+    // part of the host that the list makes a public suffix, and
+    // registrable_domain is that with the label before it.  Either is
+    // absent (its flag is not set, and its range is empty) where there is
+    // none: suffix when no entry matches the host, registrable_domain
+    // also when the host is nothing but the suffix.
+    //
+    template <typename Iterator>
+    struct suffix_match {
+        boost::iterator_range<Iterator> suffix, registrable_domain;
+        bool has_suffix, has_registrable_domain;
+
+        suffix_match(): has_suffix(false), has_registrable_domain(false) {}
+
+        bool listed() const
+        {
+            return this->has_suffix;
+        }
+    };
+
+
+    //
+    // An immutable trie of domain suffixes, keyed by label from the
+    // right, for classifying hosts against lists of many thousands of
+    // them: public suffix lists, and block or allow lists of domains.
+    //
+    // The list is plain text with an entry per line.  Anything after
+    // the first whitespace on a line is ignored, as are blank lines and
+    // lines starting with "//".  Entries follow the Public Suffix List
+    // format:
+    //
+    //   - "com" or "co.uk" is a suffix;
+    //   - "*.ck" makes any label under "ck" a suffix; and
+    //   - "!www.ck" is an exception to that: "ck" is the suffix of
+    //     "www.ck".
+    //
+    // The longest entry that matches a host wins; an exception wins over
+    // everything.  There is no implicit "*" entry: a host that matches
+    // nothing has no suffix.
+    //
+    // The trie's edges are kept in a single open-addressed hash table,
+    // keyed by the node they leave and a hash of their label; so finding
+    // the child for a label takes a probe or two however many children
+    // the node has.  Labels are in a pool of the distinct ones, all
+    // lowercased.  Hosts are matched where they lie, with ASCII letters
+    // compared without regard to case; other bytes, including pct-encoded
+    // triples, are compared as they are (so internationalized entries
+    // should be in their "xn--" form).
+    //
+    class suffix_trie {
+        enum node_flag {
+            suffix_flag    = 0x1,
+            wildcard_flag  = 0x2,
+            exception_flag = 0x4
+        };
+
+        //
+        // An empty slot has a target of zero, the root.
+        //
+        struct edge {
+            std::uint32_t parent, target, label, hash;
+        };
+
+        std::vector<std::uint8_t> flags_;
+        std::vector<edge> edges_;
+        std::string labels_;
+
+    public:
+        //
+        // Read the list from in to its end.  Throws std::invalid_argument
+        // if an entry has a label longer than 63 characters (the limit
+        // for DNS).
+        //
+        explicit suffix_trie(std::istream & in);
+
+        //
+        // Match host, which is a reg-name as host_grammar matches it.  A
+        // single trailing "." is ignored, and left out of the ranges in
+        // the result.
+        //
+        // Iterator must be bidirectional.
+        //
+        template <typename Iterator>
+        suffix_match<Iterator>
+        match(const boost::iterator_range<Iterator> & host) const;
+
+        //
+        // Match the host of each row of columns, whose offsets are
+        // relative to base (as parse_batch makes them).  Rows with no
+        // host, or one that is an IP-literal or IPv4address, get absent
+        // ranges.  The results replace the contents of suffix and
+        // registrable_domain, a row for each row of columns.
+        //
+        void match(const char * base, const component_columns & columns,
+                   std::vector<offset_range> & suffix,
+                   std::vector<offset_range> & registrable_domain) const;
+
+    private:
+        std::size_t slot(std::uint32_t parent, std::uint32_t hash) const
+        {
+            return std::size_t((std::uint64_t(parent) << 32 | hash)
+                               * 0x9e3779b97f4a7c15ULL >> 32)
+                & (this->edges_.size() - 1);
+        }
+
+        template <typename Iterator>
+        std::uint32_t find(std::uint32_t parent, Iterator first,
+                           std::uint32_t hash, std::size_t length) const;
+    };
+
+
+    namespace detail {
+
+        //
+        // The trie as it is built, before its edges are hashed.
+        //
+        struct suffix_build_node {
+            std::map<std::string, std::uint32_t> children;
+            std::uint8_t flags;
+
+            suffix_build_node(): flags(0) {}
+        };
+
+        //
+        // FNV-1a over the lowercased label, with its length in the top
+        // byte so that a match on the hash implies one on the length.
+        //
+        inline std::uint32_t label_hash(const std::uint32_t h, const char c)
+        {
+            return (h ^ static_cast<unsigned char>(to_lower(c))) * 16777619u;
+        }
+
+        inline std::uint32_t label_hash_length(const std::uint32_t h,
+                                               const std::size_t length)
+        {
+            return (h & 0x00ffffff) | std::uint32_t(length) << 24;
+        }
+
+        const std::uint32_t label_hash_basis = 2166136261u;
+    }
+
+    inline suffix_trie::suffix_trie(std::istream & in)
+    {
+        std::vector<detail::suffix_build_node> build(1);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::string::size_type begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string::npos
+                || line.compare(begin, 2, "//") == 0) {
+                continue;
+            }
+            std::string::size_type end = line.find_first_of(" \t\r", begin);
+            if (end == std::string::npos) { end = line.size(); }
+            if (line[end - 1] == '.') { --end; }
+
+            std::uint8_t flag = suffix_flag;
+            if (line[begin] == '!') {
+                flag = exception_flag;
+                ++begin;
+            } else if (line.compare(begin, 2, "*.") == 0) {
+                flag = wildcard_flag;
+                begin += 2;
+            }
+
+            std::uint32_t n = 0;
+            while (end > begin) {
+                const std::string::size_type dot = line.rfind('.', end - 1);
+                const std::string::size_type label_begin =
+                    (dot == std::string::npos || dot < begin)
+                    ? begin : dot + 1;
+                if (end - label_begin > 63) {
+                    throw std::invalid_argument("uri: suffix list label "
+                                                "longer than 63 characters");
+                }
+                std::string label(line, label_begin, end - label_begin);
+                std::transform(label.begin(), label.end(), label.begin(),
+                               detail::to_lower);
+                std::map<std::string, std::uint32_t>::iterator child =
+                    build[n].children.find(label);
+                if (child == build[n].children.end()) {
+                    child = build[n].children.insert(std::make_pair(
+                        label, std::uint32_t(build.size()))).first;
+                    build.push_back(detail::suffix_build_node());
+                }
+                n = child->second;
+                end = (label_begin == begin) ? begin : label_begin - 1;
+            }
+            if (n != 0) { build[n].flags |= flag; }
+        }
+
+        //
+        // At most half the slots are used.
+        //
+        std::size_t slots = 2;
+        while (slots < 2 * build.size()) { slots *= 2; }
+        const edge empty = { 0, 0, 0, 0 };
+        this->edges_.assign(slots, empty);
+        this->flags_.resize(build.size());
+
+        std::map<std::string, std::uint32_t> pool;
+        for (std::uint32_t parent = 0; parent < build.size(); ++parent) {
+            this->flags_[parent] = build[parent].flags;
+            for (std::map<std::string, std::uint32_t>::const_iterator child =
+                     build[parent].children.begin();
+                 child != build[parent].children.end(); ++child) {
+                const std::string & label = child->first;
+                std::map<std::string, std::uint32_t>::iterator pooled =
+                    pool.find(label);
+                if (pooled == pool.end()) {
+                    pooled = pool.insert(std::make_pair(
+                        label, std::uint32_t(this->labels_.size()))).first;
+                    this->labels_ += label;
+                }
+
+                //
+                // Hashed last character first, as match reads them.
+                //
+                std::uint32_t hash = detail::label_hash_basis;
+                for (std::string::const_reverse_iterator c = label.rbegin();
+                     c != label.rend(); ++c) {
+                    hash = detail::label_hash(hash, *c);
+                }
+                hash = detail::label_hash_length(hash, label.size());
+
+                std::size_t i = this->slot(parent, hash);
+                while (this->edges_[i].target != 0) {
+                    i = (i + 1) & (slots - 1);
+                }
+                const edge e = {
+                    parent, child->second, pooled->second, hash
+                };
+                this->edges_[i] = e;
+            }
+        }
+    }
+
+    //
+    // The child of parent by the label of length characters at first, or
+    // zero (the root) if there is none.
+    //
+    template <typename Iterator>
+    std::uint32_t suffix_trie::find(const std::uint32_t parent,
+                                    const Iterator first,
+                                    const std::uint32_t hash,
+                                    const std::size_t length) const
+    {
+        const std::size_t mask = this->edges_.size() - 1;
+        for (std::size_t i = this->slot(parent, hash); ;
+             i = (i + 1) & mask) {
+            const edge & e = this->edges_[i];
+            if (e.target == 0) { return 0; }
+            if (e.hash != hash || e.parent != parent) { continue; }
+            const char * label = this->labels_.data() + e.label;
+            Iterator c = first;
+            std::size_t k = 0;
+            while (k != length && detail::to_lower(*c) == *label) {
+                ++k;
+                ++c;
+                ++label;
+            }
+            if (k == length) { return e.target; }
+        }
+    }
+
+    template <typename Iterator>
+    suffix_match<Iterator>
+    suffix_trie::match(const boost::iterator_range<Iterator> & host) const
+    {
+        suffix_match<Iterator> result;
+        const Iterator first = host.begin();
+        Iterator last = host.end();
+        if (first != last) {
+            Iterator i = last;
+            if (*--i == '.') { last = i; }
+        }
+
+        //
+        // Walk the labels from the right.  suffix is where the longest
+        // match found so far begins; it is last if there is none.
+        //
+        Iterator suffix = last;
+        std::uint32_t n = 0;
+        for (Iterator end = last; ; ) {
+            Iterator label = end;
+            std::size_t length = 0;
+            std::uint32_t hash = detail::label_hash_basis;
+            while (label != first) {
+                Iterator i = label;
+                if (*--i == '.') { break; }
+                hash = detail::label_hash(hash, *i);
+                label = i;
+                ++length;
+            }
+            if (length > 63) { break; }
+            hash = detail::label_hash_length(hash, length);
+
+            const std::uint32_t child = this->find(n, label, hash, length);
+            if (this->flags_[child] & exception_flag) {
+                if (end != last) { suffix = std::next(end); }
+                break;
+            }
+            if ((this->flags_[n] & wildcard_flag)
+                || (this->flags_[child] & suffix_flag)) {
+                suffix = label;
+            }
+            if (child == 0 || label == first) { break; }
+            n = child;
+            end = std::prev(label);
+        }
+
+        if (suffix == last) { return result; }
+        result.suffix = boost::make_iterator_range(suffix, last);
+        result.has_suffix = true;
+        if (suffix != first) {
+            //
+            // suffix follows a "."; an empty label before that (as in
+            // "a..com") makes no registrable domain.
+            //
+            const Iterator dot = std::prev(suffix);
+            Iterator label = dot;
+            while (label != first) {
+                Iterator i = label;
+                if (*--i == '.') { break; }
+                label = i;
+            }
+            if (label != dot) {
+                result.registrable_domain =
+                    boost::make_iterator_range(label, last);
+                result.has_registrable_domain = true;
+            }
+        }
+        return result;
+    }
+
+    inline void
+    suffix_trie::match(const char * const base,
+                       const component_columns & columns,
+                       std::vector<offset_range> & suffix,
+                       std::vector<offset_range> & registrable_domain) const
+    {
+        const offset_range absent = { offset_range::absent, 0 };
+        suffix.assign(columns.size(), absent);
+        registrable_domain.assign(columns.size(), absent);
+        for (std::size_t row = 0; row < columns.size(); ++row) {
+            const offset_range host = columns.host[row];
+            if (!host.present() || columns.host_type[row] != reg_name_host) {
+                continue;
+            }
+            const char * const first = base + host.begin;
+            const suffix_match<const char *> m =
+                this->match(boost::make_iterator_range(first,
+                                                       first + host.length));
+            suffix[row] =
+                detail::make_offset_range(base, m.suffix, m.has_suffix);
+            registrable_domain[row] =
+                detail::make_offset_range(base, m.registrable_domain,
+                                          m.has_registrable_domain);
+        }
+    }
+} // namespace uri
+
+# endif // ifndef URI_SUFFIX_TRIE_HPP
@@ -0,0 +1,724 @@
+// -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
+//
+// Copyright 2010  Braden McDaniel
+//
+// Distributed under the Boost Software License, Version 1.0.
+//
+// See accompanying file COPYING or copy at
+// http://www.boost.org/LICENSE_1_0.txt
+//
+
+//
+// Parser benchmarks; built and run by "make bench".  Results are written
+// to standard output as a single JSON object.
+//
+
+# include <uri/extract.hpp>
+# include <uri/grammar.hpp>
+# include <uri/scanner.hpp>
+# include <uri/scheme_profile.hpp>
+# include <uri/suffix_trie.hpp>
+# include <boost/program_options.hpp>
+# include <chrono>
+# include <cstdint>
+# include <cstdio>
+# include <cstring>
+# include <iostream>
+# include <sstream>
+# include <string>
+# include <unordered_set>
+# include <vector>
+
+namespace {
+
+    namespace qi = boost::spirit::qi;
+
+    //
+    // A xorshift64* generator.  The standard distributions are not the
+    // same across library implementations; this keeps the corpus the same
+    // everywhere for a given seed.
+    //
+    class random_source {
+        std::uint64_t state_;
+
+    public:
+        explicit random_source(const std::uint64_t seed):
+            state_(seed ? seed : 0x9e3779b97f4a7c15ULL)
+        {}
+
+        std::uint64_t next()
+        {
+            this->state_ ^= this->state_ >> 12;
+            this->state_ ^= this->state_ << 25;
+            this->state_ ^= this->state_ >> 27;
+            return this->state_ * 0x2545f4914f6cdd1dULL;
+        }
+
+        unsigned below(const unsigned n)
+        {
+            return unsigned((this->next() >> 32) % n);
+        }
+    };
+
+    //
+    // Builds URIs and URI pieces of the kinds the benchmarks run over.
+    //
+    class corpus_generator {
+        random_source random_;
+
+        const char * word()
+        {
+            static const char * const words[] = {
+                "index", "search", "images", "static", "api", "v2", "users",
+                "profile", "news", "article", "2010", "docs", "download",
+                "example", "assets", "en-US", "item_42", "page", "a", "x~y"
+            };
+            return words[this->random_.below(sizeof words / sizeof words[0])];
+        }
+
+        std::string path(const unsigned max_segments)
+        {
+            std::string result;
+            const unsigned n = 1 + this->random_.below(max_segments);
+            for (unsigned i = 0; i < n; ++i) {
+                result += '/';
+                result += this->word();
+            }
+            return result;
+        }
+
+        std::string hex_group()
+        {
+            static const char digits[] = "0123456789abcdef";
+            std::string result;
+            const unsigned n = 1 + this->random_.below(4);
+            for (unsigned i = 0; i < n; ++i) {
+                result += digits[this->random_.below(16)];
+            }
+            return result;
+        }
+
+    public:
+        explicit corpus_generator(const std::uint64_t seed):
+            random_(seed)
+        {}
+
+        std::string authority()
+        {
+            std::string result;
+            if (this->random_.below(8) == 0) { result += "user@"; }
+            if (this->random_.below(4) == 0) { result += "www."; }
+            result += this->word();
+            result += this->random_.below(2) ? ".com" : ".example.org";
+            if (this->random_.below(4) == 0) { result += ":8080"; }
+            return result;
+        }
+
+        std::string query(const unsigned min_params,
+                          const unsigned max_params)
+        {
+            std::string result;
+            const unsigned n =
+                min_params + this->random_.below(max_params - min_params + 1);
+            for (unsigned i = 0; i < n; ++i) {
+                if (i > 0) { result += '&'; }
+                result += this->word();
+                result += '=';
+                result += this->word();
+                if (this->random_.below(4) == 0) { result += "%20"; }
+            }
+            return result;
+        }
+
+        std::string ipv6_address()
+        {
+            std::string groups[8];
+            for (auto & g : groups) { g = this->hex_group(); }
+            switch (this->random_.below(4)) {
+            case 0:
+                return "::ffff:" + std::to_string(this->random_.below(256))
+                    + ".0.2." + std::to_string(this->random_.below(256));
+            case 1:
+                return groups[0] + "::" + groups[1];
+            case 2:
+                return groups[0] + ':' + groups[1] + "::" + groups[2] + ':'
+                    + groups[3] + ':' + groups[4];
+            default:
+                {
+                    std::string result = groups[0];
+                    for (unsigned i = 1; i < 8; ++i) {
+                        result += ':';
+                        result += groups[i];
+                    }
+                    return result;
+                }
+            }
+        }
+
+        //
+        // A host of one or two words under "com", "co.uk", one of the
+        // listed suffixes "s<n>.example", or (a quarter of the time) a
+        // suffix that is not listed.
+        //
+        std::string host(const unsigned listed)
+        {
+            std::string result = this->word();
+            if (this->random_.below(2)) {
+                result += '.';
+                result += this->word();
+            }
+            switch (this->random_.below(4)) {
+            case 0: return result + ".com";
+            case 1: return result + ".co.uk";
+            case 2:
+                return result + ".s"
+                    + std::to_string(this->random_.below(listed))
+                    + ".example";
+            default: return result + ".unlisted";
+            }
+        }
+
+        std::string short_http()
+        {
+            return "http://" + this->authority() + this->path(3);
+        }
+
+        std::string long_query()
+        {
+            return "https://" + this->authority() + this->path(2) + '?'
+                + this->query(20, 60);
+        }
+
+        std::string pct_heavy()
+        {
+            static const char digits[] = "0123456789ABCDEF";
+            std::string result = "http://" + this->authority();
+            const unsigned segments = 1 + this->random_.below(4);
+            for (unsigned s = 0; s < segments; ++s) {
+                result += '/';
+                const unsigned n = 4 + this->random_.below(16);
+                for (unsigned i = 0; i < n; ++i) {
+                    result += '%';
+                    result += digits[8 + this->random_.below(8)];
+                    result += digits[this->random_.below(16)];
+                }
+            }
+            return result;
+        }
+
+        std::string ipv6_literal()
+        {
+            return "http://[" + this->ipv6_address() + "]:8080"
+                + this->path(2);
+        }
+
+        //
+        // Words and punctuation, with no URI in them, of about size
+        // characters.
+        //
+        std::string prose(const std::size_t size)
+        {
+            static const char * const separators[] = {
+                " ", " ", " ", " ", ", ", ". ", ": ", "\n"
+            };
+            std::string result;
+            while (result.size() < size) {
+                result += this->word();
+                result += separators[this->random_.below(
+                    sizeof separators / sizeof separators[0])];
+            }
+            return result;
+        }
+
+        //
+        // Log lines of about size characters in all, each with a URI.
+        //
+        std::string log(const std::size_t size)
+        {
+            std::string result;
+            while (result.size() < size) {
+                result += "2010-06-01 12:";
+                result += std::to_string(10 + this->random_.below(50));
+                result += ":00 GET ";
+                result += this->random_.below(4)
+                    ? this->short_http()
+                    : "www." + this->authority() + this->path(2);
+                result += " 200 \"";
+                result += this->word();
+                result += "\"\n";
+            }
+            return result;
+        }
+
+        std::string relative_ref()
+        {
+            switch (this->random_.below(5)) {
+            case 0: return std::string("../") + this->word() + this->path(2);
+            case 1: return this->path(4) + '?' + this->query(1, 3);
+            case 2: return '?' + this->query(1, 4);
+            case 3: return std::string("#") + this->word();
+            default: return "//" + this->authority() + this->path(2);
+            }
+        }
+    };
+
+    struct corpus {
+        std::string name;
+        std::vector<std::string> inputs;
+
+        std::size_t bytes() const
+        {
+            std::size_t n = 0;
+            for (const auto & s : this->inputs) { n += s.size(); }
+            return n;
+        }
+    };
+
+    template <typename Generate>
+    corpus make_corpus(const char * const name, const std::size_t count,
+                       Generate generate)
+    {
+        corpus result;
+        result.name = name;
+        result.inputs.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            result.inputs.push_back(generate());
+        }
+        return result;
+    }
+
+    template <typename Iterator>
+    struct iterator_info;
+
+    template <>
+    struct iterator_info<std::string::const_iterator> {
+        static const char * name() { return "std::string::const_iterator"; }
+
+        static std::string::const_iterator begin(const std::string & s)
+        {
+            return s.begin();
+        }
+
+        static std::string::const_iterator end(const std::string & s)
+        {
+            return s.end();
+        }
+    };
+
+    template <>
+    struct iterator_info<const char *> {
+        static const char * name() { return "const char *"; }
+
+        static const char * begin(const std::string & s)
+        {
+            return s.data();
+        }
+
+        static const char * end(const std::string & s)
+        {
+            return s.data() + s.size();
+        }
+    };
+
+    //
+    // Keeps the compiler from discarding the work being timed.
+    //
+    volatile std::size_t sink;
+
+    //
+    // The fastest of runs calls of f, in seconds.
+    //
+    template <typename F>
+    double best_time(const unsigned runs, F f)
+    {
+        typedef std::chrono::steady_clock clock;
+        double best = 0;
+        for (unsigned i = 0; i < runs; ++i) {
+            const clock::time_point start = clock::now();
+            sink = sink + f();
+            const std::chrono::duration<double> elapsed = clock::now() - start;
+            if (i == 0 || elapsed.count() < best) { best = elapsed.count(); }
+        }
+        return best;
+    }
+
+    //
+    // Writes the arrays of flat objects that make up the report.
+    //
+    class json_report {
+        bool first_member_, in_array_, first_object_, first_field_;
+
+    public:
+        json_report():
+            first_member_(true),
+            in_array_(false),
+            first_object_(true),
+            first_field_(true)
+        {
+            std::cout << '{';
+        }
+
+        ~json_report()
+        {
+            std::cout << (this->in_array_ ? "\n  ]\n}\n" : "\n}\n");
+        }
+
+        void field(const char * const name, const std::string & value)
+        {
+            this->begin_field(name);
+            std::cout << '"' << value << '"';
+        }
+
+        void field(const char * const name, const double value)
+        {
+            this->begin_field(name);
+            std::cout << value;
+        }
+
+        void begin_array(const char * const name)
+        {
+            if (this->in_array_) { std::cout << "\n  ]"; }
+            this->begin_member(name);
+            std::cout << '[';
+            this->in_array_ = true;
+            this->first_object_ = true;
+        }
+
+        void begin_object()
+        {
+            std::cout << (this->first_object_ ? "\n    {" : ",\n    {");
+            this->first_object_ = false;
+            this->first_field_ = true;
+        }
+
+        void end_object()
+        {
+            std::cout << '}';
+        }
+
+    private:
+        void begin_member(const char * const name)
+        {
+            std::cout << (this->first_member_ ? "\n  \"" : ",\n  \"")
+                      << name << "\": ";
+            this->first_member_ = false;
+        }
+
+        //
+        // Fields outside an array are members of the report itself.
+        //
+        void begin_field(const char * const name)
+        {
+            if (!this->in_array_) {
+                this->begin_member(name);
+                return;
+            }
+            if (!this->first_field_) { std::cout << ", "; }
+            this->first_field_ = false;
+            std::cout << '"' << name << "\": ";
+        }
+    };
+
+    template <typename F>
+    void construction(json_report & report, const char * const grammar,
+                      const char * const iterator, const unsigned count,
+                      F construct)
+    {
+        const double seconds = best_time(3, [&] {
+            std::size_t n = 0;
+            for (unsigned i = 0; i < count; ++i) { n += construct(); }
+            return n;
+        });
+        report.begin_object();
+        report.field("grammar", grammar);
+        report.field("iterator", iterator);
+        report.field("ns", seconds * 1e9 / count);
+        report.end_object();
+    }
+
+    template <typename Iterator>
+    void construction_costs(json_report & report)
+    {
+        typedef iterator_info<Iterator> traits;
+        const unsigned count = 200;
+        construction(report, "grammar", traits::name(), count, [] {
+            uri::components<Iterator> c;
+            const uri::grammar<Iterator> g(c);
+            return sizeof g;
+        });
+        construction(report, "components_grammar", traits::name(), count, [] {
+            const uri::components_grammar<Iterator> g;
+            return sizeof g;
+        });
+        construction(report, "validator_grammar", traits::name(), count, [] {
+            const uri::validator_grammar<Iterator> g;
+            return sizeof g;
+        });
+        construction(report, "authority_grammar", traits::name(), count, [] {
+            uri::components<Iterator> c;
+            const uri::authority_grammar<Iterator> g(c);
+            return sizeof g;
+        });
+        construction(report, "ipv6_grammar", traits::name(), count, [] {
+            const uri::ipv6_grammar<Iterator> g;
+            return sizeof g;
+        });
+    }
+
+    //
+    // Time parse(first, last) over every input of c, which returns whether
+    // the whole input was matched.
+    //
+    template <typename Iterator, typename Parse>
+    void throughput(json_report & report, const corpus & c,
+                    const char * const parser, const unsigned runs,
+                    Parse parse)
+    {
+        typedef iterator_info<Iterator> traits;
+        std::size_t matched = 0;
+        const double seconds = best_time(runs, [&] {
+            matched = 0;
+            for (const auto & s : c.inputs) {
+                if (parse(traits::begin(s), traits::end(s))) { ++matched; }
+            }
+            return matched;
+        });
+        const double bytes = double(c.bytes());
+        report.begin_object();
+        report.field("input", c.name);
+        report.field("parser", parser);
+        report.field("iterator", traits::name());
+        report.field("count", double(c.inputs.size()));
+        report.field("bytes", bytes);
+        report.field("matched", double(matched));
+        report.field("seconds", seconds);
+        report.field("mb_per_s", bytes / seconds / 1e6);
+        report.field("items_per_s", double(c.inputs.size()) / seconds);
+        report.end_object();
+    }
+
+    template <typename Iterator>
+    void uri_throughput(json_report & report,
+                        const std::vector<corpus> & corpora,
+                        const unsigned runs)
+    {
+        uri::components<Iterator> c;
+        const uri::grammar<Iterator> g(c);
+        const uri::validator_grammar<Iterator> validator;
+        for (const auto & input : corpora) {
+            throughput<Iterator>(report, input, "grammar", runs,
+                                 [&](Iterator first, const Iterator last) {
+                c = uri::components<Iterator>();
+                qi::parse(first, last, g);
+                return first == last;
+            });
+            throughput<Iterator>(report, input, "validator_grammar", runs,
+                                 [&](Iterator first, const Iterator last) {
+                qi::parse(first, last, validator);
+                return first == last;
+            });
+            throughput<Iterator>(report, input, "scan", runs,
+                                 [&](Iterator first, const Iterator last) {
+                c = uri::components<Iterator>();
+                uri::scan(first, last, c);
+                return first == last;
+            });
+            throughput<Iterator>(report, input, "web_profiles", runs,
+                                 [&](Iterator first, const Iterator last) {
+                uri::profiled_components<Iterator> pc;
+                uri::web_profiles::parse(first, last, pc);
+                return first == last;
+            });
+        }
+    }
+
+    template <typename Iterator>
+    void subgrammar_throughput(json_report & report,
+                               const corpus & authorities,
+                               const corpus & queries,
+                               const corpus & ipv6_addresses,
+                               const unsigned runs)
+    {
+        uri::components<Iterator> c;
+        const uri::authority_grammar<Iterator> authority(c);
+        throughput<Iterator>(report, authorities, "authority_grammar", runs,
+                             [&](Iterator first, const Iterator last) {
+            qi::parse(first, last, authority);
+            return first == last;
+        });
+
+        const uri::query_grammar<Iterator> query;
+        throughput<Iterator>(report, queries, "query_grammar", runs,
+                             [&](Iterator first, const Iterator last) {
+            qi::parse(first, last, query);
+            return first == last;
+        });
+
+        const uri::ipv6_grammar<Iterator> ipv6;
+        boost::array<std::uint16_t, 8> address;
+        throughput<Iterator>(report, ipv6_addresses, "ipv6_grammar", runs,
+                             [&](Iterator first, const Iterator last) {
+            qi::parse(first, last, ipv6, address);
+            return first == last;
+        });
+    }
+
+    //
+    // Time extract_uris over text, alongside copying it.
+    //
+    void extract_throughput(json_report & report, const char * const name,
+                            const std::string & text, const unsigned runs)
+    {
+        std::size_t found = 0;
+        const double seconds = best_time(runs, [&] {
+            found = 0;
+            for (const auto & u :
+                     uri::extract_uris(text.data(),
+                                       text.data() + text.size())) {
+                found += !u.text.empty();
+            }
+            return found;
+        });
+        std::vector<char> copy(text.size());
+        const double copy_seconds = best_time(runs, [&] {
+            std::memcpy(copy.data(), text.data(), text.size());
+            return std::size_t(copy[text.size() / 2]);
+        });
+        const double bytes = double(text.size());
+        report.begin_object();
+        report.field("input", name);
+        report.field("bytes", bytes);
+        report.field("found", double(found));
+        report.field("seconds", seconds);
+        report.field("mb_per_s", bytes / seconds / 1e6);
+        report.field("memcpy_mb_per_s", bytes / copy_seconds / 1e6);
+        report.end_object();
+    }
+
+    //
+    // Time suffix_trie against splitting each host into lowercased
+    // suffixes and looking them up in a hash set, longest first.
+    //
+    void suffix_throughput(json_report & report, const corpus & hosts,
+                           const unsigned listed, const unsigned runs)
+    {
+        std::string list = "com\nco.uk\n";
+        for (unsigned i = 0; i < listed; ++i) {
+            list += 's' + std::to_string(i) + ".example\n";
+        }
+        std::istringstream in(list);
+        const uri::suffix_trie trie(in);
+        throughput<const char *>(report, hosts, "suffix_trie", runs,
+                                 [&](const char * const first,
+                                     const char * const last) {
+            return trie.match(boost::make_iterator_range(first, last))
+                .listed();
+        });
+
+        std::unordered_set<std::string> set;
+        std::istringstream entries(list);
+        for (std::string entry; std::getline(entries, entry);) {
+            set.insert(entry);
+        }
+        throughput<const char *>(report, hosts, "label_hash", runs,
+                                 [&](const char * const first,
+                                     const char * const last) {
+            std::string host(first, last);
+            std::transform(host.begin(), host.end(), host.begin(),
+                           uri::detail::to_lower);
+            for (std::string::size_type dot = host.find('.');
+                 dot != std::string::npos; dot = host.find('.', dot + 1)) {
+                if (set.count(host.substr(dot + 1))) { return true; }
+            }
+            return false;
+        });
+    }
+}
+
+int main(int argc, char * argv[])
+{
+    using namespace boost::program_options;
+    using namespace std;
+
+    typedef string::const_iterator string_iterator;
+
+    try {
+        options_description opts("Allowed options");
+        opts.add_options()
+            ("help",  "Print help message")
+            ("count", value<size_t>()->default_value(20000),
+                      "Number of inputs in each corpus")
+            ("runs",  value<unsigned>()->default_value(5),
+                      "Number of timed runs; the fastest is reported")
+            ("seed",  value<uint64_t>()->default_value(1),
+                      "Corpus generator seed");
+
+        variables_map option_map;
+        store(parse_command_line(argc, argv, opts), option_map);
+        notify(option_map);
+
+        if (option_map.count("help")) {
+            cout << "Usage: uri-bench [options]\n" << opts;
+            return EXIT_SUCCESS;
+        }
+
+        const size_t count = option_map["count"].as<size_t>();
+        const unsigned runs = max(1u, option_map["runs"].as<unsigned>());
+        const uint64_t seed = option_map["seed"].as<uint64_t>();
+
+        corpus_generator gen(seed);
+        vector<corpus> corpora;
+        corpora.push_back(make_corpus("short_http", count,
+                                      [&] { return gen.short_http(); }));
+        corpora.push_back(make_corpus("long_query", count,
+                                      [&] { return gen.long_query(); }));
+        corpora.push_back(make_corpus("pct_heavy", count,
+                                      [&] { return gen.pct_heavy(); }));
+        corpora.push_back(make_corpus("ipv6_literal", count,
+                                      [&] { return gen.ipv6_literal(); }));
+        corpora.push_back(make_corpus("relative_ref", count,
+                                      [&] { return gen.relative_ref(); }));
+
+        const corpus authorities =
+            make_corpus("authority", count, [&] { return gen.authority(); });
+        const corpus queries =
+            make_corpus("query", count, [&] { return gen.query(1, 20); });
+        const corpus ipv6_addresses =
+            make_corpus("ipv6_address", count,
+                        [&] { return gen.ipv6_address(); });
+        const string prose = gen.prose(count * 100);
+        const string log = gen.log(count * 100);
+        const unsigned listed = 100000;
+        const corpus hosts =
+            make_corpus("host", count, [&] { return gen.host(listed); });
+
+        json_report report;
+        report.field("seed", double(seed));
+        report.field("count", double(count));
+        report.field("runs", double(runs));
+
+        report.begin_array("construction");
+        construction_costs<string_iterator>(report);
+        construction_costs<const char *>(report);
+
+        report.begin_array("parse");
+        uri_throughput<string_iterator>(report, corpora, runs);
+        uri_throughput<const char *>(report, corpora, runs);
+
+        report.begin_array("subgrammar");
+        subgrammar_throughput<string_iterator>(report, authorities, queries,
+                                               ipv6_addresses, runs);
+        subgrammar_throughput<const char *>(report, authorities, queries,
+                                            ipv6_addresses, runs);
+
+        report.begin_array("extract");
+        extract_throughput(report, "prose", prose, runs);
+        extract_throughput(report, "log", log, runs);
+
+        report.begin_array("suffix");
+        suffix_throughput(report, hosts, listed, runs);
+    } catch (const exception & ex) {
+        cerr << "error: " << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+}
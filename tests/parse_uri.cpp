@@ -8,9 +8,448 @@
 // http://www.boost.org/LICENSE_1_0.txt
 //
 
+# include <uri/column_index.hpp>
 # include <uri/grammar.hpp>
+# include <uri/parallel.hpp>
 # include <boost/program_options.hpp>
+# include <algorithm>
+# include <cerrno>
+# include <cstdio>
+# include <cstring>
+# include <fstream>
 # include <iostream>
+# include <stdexcept>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+
+namespace {
+
+    const char * const component_names[] = {
+        "scheme", "userinfo", "host", "port", "path", "query", "fragment"
+    };
+
+    std::vector<uri::offset_range> uri::component_columns::* const
+    component_columns[] = {
+        &uri::component_columns::scheme,
+        &uri::component_columns::userinfo,
+        &uri::component_columns::host,
+        &uri::component_columns::port,
+        &uri::component_columns::path,
+        &uri::component_columns::query,
+        &uri::component_columns::fragment
+    };
+
+    boost::iterator_range<const uri::offset_range *>
+    (uri::column_index::* const index_columns[])() const = {
+        &uri::column_index::scheme,
+        &uri::column_index::userinfo,
+        &uri::column_index::host,
+        &uri::column_index::port,
+        &uri::column_index::path,
+        &uri::column_index::query,
+        &uri::column_index::fragment
+    };
+
+    const std::size_t component_count =
+        sizeof component_names / sizeof component_names[0];
+
+    const uri::offset_range &
+    component_range(const uri::component_columns & columns,
+                    const std::size_t component, const std::size_t row)
+    {
+        return (columns.*component_columns[component])[row];
+    }
+
+    const uri::offset_range &
+    component_range(const uri::column_index & index,
+                    const std::size_t component, const std::size_t row)
+    {
+        return (index.*index_columns[component])()[row];
+    }
+
+    //
+    // Accumulates output and hands it to stdout in large writes.
+    //
+    class output_buffer {
+        std::string buf_;
+
+    public:
+        explicit output_buffer(const std::size_t capacity)
+        {
+            this->buf_.reserve(capacity);
+        }
+
+        ~output_buffer()
+        {
+            this->flush();
+        }
+
+        void write(const char * const data, const std::size_t size)
+        {
+            if (this->buf_.size() + size > this->buf_.capacity()) {
+                this->flush();
+            }
+            this->buf_.append(data, size);
+        }
+
+        void write(const char * const str)
+        {
+            this->write(str, std::strlen(str));
+        }
+
+        void put(const char c)
+        {
+            this->write(&c, 1);
+        }
+
+        void flush()
+        {
+            std::fwrite(this->buf_.data(), 1, this->buf_.size(), stdout);
+            this->buf_.clear();
+        }
+    };
+
+    //
+    // rule_counts is null unless --rule-stats is given; it is then the
+    // grammar's rule counts, summed over the blocks processed so far.
+    //
+    struct bulk_options {
+        std::vector<std::size_t> components;
+        bool json;
+        unsigned threads;
+        std::vector<uri::rule_statistics> * rule_counts;
+    };
+
+    //
+    // Parse each nonempty line of [first, last) with uri::grammar, for
+    // the sake of the rule counts; bulk parsing goes through the scanner,
+    // which does not use the grammar's rules.
+    //
+    void count_rules(const char * first, const char * const last)
+    {
+        uri::components<const char *> c;
+        const uri::grammar<const char *> g(c);
+        while (first != last) {
+            const char * line_end = first;
+            while (line_end != last && *line_end != '\n'
+                   && *line_end != '\r') {
+                ++line_end;
+            }
+            if (line_end != first) {
+                const char * pos = first;
+                boost::spirit::qi::parse(pos, line_end, g);
+            }
+            first = (line_end == last) ? last : line_end + 1;
+        }
+    }
+
+    //
+    // Add the current counts to totals.  Rules keep their places in a
+    // snapshot once they have one, so the two line up.
+    //
+    void add_rule_counts(std::vector<uri::rule_statistics> & totals)
+    {
+        const std::vector<uri::rule_statistics> stats = uri::rule_snapshot();
+        totals.resize(stats.size());
+        for (std::size_t i = 0; i < stats.size(); ++i) {
+            uri::rule_statistics & t = totals[i];
+            t.name = stats[i].name;
+            t.invocations += stats[i].invocations;
+            t.successes += stats[i].successes;
+            t.backtracks += stats[i].backtracks;
+            t.bytes += stats[i].bytes;
+            t.cycles += stats[i].cycles;
+        }
+    }
+
+    void write_rule_stats(const std::vector<uri::rule_statistics> & stats)
+    {
+        if (stats.empty()) {
+            std::fputs("parse-uri: rule counts are not compiled in "
+                       "(configure with --enable-instrumentation)\n",
+                       stderr);
+            return;
+        }
+        std::fprintf(stderr, "%-16s %12s %12s %12s %14s %16s\n", "rule",
+                     "invocations", "successes", "backtracks", "bytes",
+                     "cycles");
+        for (std::size_t i = 0; i < stats.size(); ++i) {
+            const uri::rule_statistics & s = stats[i];
+            std::fprintf(stderr, "%-16s %12llu %12llu %12llu %14llu %16llu\n",
+                         s.name.c_str(),
+                         static_cast<unsigned long long>(s.invocations),
+                         static_cast<unsigned long long>(s.successes),
+                         static_cast<unsigned long long>(s.backtracks),
+                         static_cast<unsigned long long>(s.bytes),
+                         static_cast<unsigned long long>(s.cycles));
+        }
+    }
+
+    //
+    // Component text is URI characters only; the sole ones needing a JSON
+    // escape are the backslash sub_delims_grammar admits and '"'.
+    //
+    void write_json_string(output_buffer & out,
+                           const char * first, const char * const last)
+    {
+        out.put('"');
+        for (const char * run = first; first != last; run = first) {
+            while (first != last && *first != '\\' && *first != '"') {
+                ++first;
+            }
+            out.write(run, first - run);
+            if (first != last) {
+                out.put('\\');
+                out.put(*first++);
+            }
+        }
+        out.put('"');
+    }
+
+    //
+    // Write rows [first_row, last_row) of columns, a component_columns or
+    // a column_index, whose offsets are relative to base.
+    //
+    template <typename Columns>
+    void write_rows(const char * const base,
+                    const Columns & columns,
+                    const std::size_t first_row,
+                    const std::size_t last_row,
+                    const bulk_options & opts,
+                    output_buffer & out)
+    {
+        for (std::size_t row = first_row; row < last_row; ++row) {
+            if (opts.json) { out.put('{'); }
+            for (std::size_t i = 0; i < opts.components.size(); ++i) {
+                const std::size_t component = opts.components[i];
+                const uri::offset_range & r =
+                    component_range(columns, component, row);
+                if (opts.json) {
+                    out.put('"');
+                    out.write(component_names[component]);
+                    out.write("\":");
+                    if (r.present()) {
+                        write_json_string(out, base + r.begin,
+                                          base + r.begin + r.length);
+                    } else {
+                        out.write("null");
+                    }
+                    out.put(',');
+                } else {
+                    if (i > 0) { out.put('\t'); }
+                    if (r.present()) { out.write(base + r.begin, r.length); }
+                }
+            }
+            //
+            // An invalid line's components are those of the longest
+            // URI-reference it starts with.
+            //
+            if (opts.json) {
+                out.write("\"valid\":");
+                out.write(columns.is_valid(row) ? "true}" : "false}");
+            } else {
+                out.put('\t');
+                out.write(columns.is_valid(row) ? "true" : "false");
+            }
+            out.put('\n');
+        }
+    }
+
+    //
+    // Parse and write the URIs in [first, last), which must end at a line
+    // boundary.
+    //
+    void process_block(const char * const first, const char * const last,
+                       const bulk_options & opts,
+                       uri::component_columns & columns,
+                       output_buffer & out)
+    {
+        if (opts.threads != 1) {
+            uri::parallel_parse(first, last, columns, "\r\n", opts.threads);
+        } else {
+            uri::parse_batch(first, last, columns, "\r\n");
+        }
+        if (opts.rule_counts) {
+            //
+            // The scanner hands IP-literals to host_grammar, whose rules
+            // count them too; only the grammar pass is to be counted.
+            //
+            uri::reset_rule_statistics();
+            count_rules(first, last);
+            add_rule_counts(*opts.rule_counts);
+        }
+        write_rows(first, columns, 0, columns.size(), opts, out);
+    }
+
+    const std::size_t block_size = 64 * 1024 * 1024;
+
+    //
+    // A file mapped read-only for as long as the mapped_file exists.  An
+    // empty file has a null data.
+    //
+    class mapped_file {
+        void * data_;
+        std::size_t size_;
+
+        mapped_file(const mapped_file &);
+        mapped_file & operator=(const mapped_file &);
+
+    public:
+        mapped_file(const char * const filename, const int advice):
+            data_(0),
+            size_(0)
+        {
+            const int fd = open(filename, O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error(std::string("cannot open ")
+                                         + filename + ": "
+                                         + std::strerror(errno));
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0) {
+                close(fd);
+                throw std::runtime_error(std::string("cannot stat ")
+                                         + filename + ": "
+                                         + std::strerror(errno));
+            }
+            this->size_ = st.st_size;
+            if (this->size_ == 0) {
+                close(fd);
+                return;
+            }
+            this->data_ = mmap(0, this->size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (this->data_ == MAP_FAILED) {
+                this->data_ = 0;
+                throw std::runtime_error(std::string("cannot map ")
+                                         + filename + ": "
+                                         + std::strerror(errno));
+            }
+            madvise(this->data_, this->size_, advice);
+        }
+
+        ~mapped_file()
+        {
+            if (this->data_) { munmap(this->data_, this->size_); }
+        }
+
+        const char * data() const
+        {
+            return static_cast<const char *>(this->data_);
+        }
+
+        std::size_t size() const
+        {
+            return this->size_;
+        }
+    };
+
+    void process_file(const char * const filename,
+                      const bulk_options & opts,
+                      output_buffer & out)
+    {
+        const mapped_file file(filename, MADV_SEQUENTIAL);
+        const char * const last = file.data() + file.size();
+        uri::component_columns columns;
+        for (const char * block = file.data(); block != last;) {
+            const char * block_end =
+                (std::size_t(last - block) > block_size)
+                ? block + block_size
+                : last;
+            while (block_end != last && *(block_end - 1) != '\n') {
+                ++block_end;
+            }
+            process_block(block, block_end, opts, columns, out);
+            block = block_end;
+        }
+    }
+
+    //
+    // Write the rows of filename from the column index made of it, without
+    // parsing it again.
+    //
+    void process_indexed_file(const char * const filename,
+                              const char * const index_filename,
+                              const bulk_options & opts,
+                              output_buffer & out)
+    {
+        const mapped_file file(filename, MADV_RANDOM);
+        const mapped_file index_file(index_filename, MADV_SEQUENTIAL);
+        const uri::column_index index(index_file.data(), index_file.size());
+        if (index.source_size() != file.size()) {
+            throw std::runtime_error(std::string(index_filename)
+                                     + " is not an index of " + filename);
+        }
+        const boost::iterator_range<const uri::index_segment *> segments =
+            index.segments();
+        for (const uri::index_segment * s = segments.begin();
+             s != segments.end(); ++s) {
+            const std::size_t last_row = (s + 1 == segments.end())
+                ? index.size()
+                : std::size_t((s + 1)->first_row);
+            write_rows(file.data() + s->base, index, s->first_row, last_row,
+                       opts, out);
+        }
+    }
+
+    void write_index(const char * const filename,
+                     const char * const index_filename)
+    {
+        const mapped_file file(filename, MADV_SEQUENTIAL);
+        std::ofstream out(index_filename, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error(std::string("cannot open ")
+                                     + index_filename);
+        }
+        uri::write_column_index(out, file.data(), file.data() + file.size(),
+                                "\r\n");
+    }
+
+    //
+    // Read standard input as it arrives: whatever each read returns is
+    // processed up to its last complete line, and the output for it is
+    // written before reading again, so that a slow or live pipe is not
+    // held up waiting for a full block.
+    //
+    void process_stdin(const bulk_options & opts, output_buffer & out)
+    {
+        std::vector<char> buf(block_size);
+        std::size_t filled = 0;
+        uri::component_columns columns;
+        for (;;) {
+            if (filled == buf.size()) {
+                //
+                // A single line fills the buffer; make room for more.
+                //
+                buf.resize(buf.size() * 2);
+            }
+            const ssize_t n = ::read(STDIN_FILENO, &buf[filled],
+                                     buf.size() - filled);
+            if (n < 0) {
+                if (errno == EINTR) { continue; }
+                throw std::runtime_error("error reading standard input");
+            }
+            const bool eof = (n == 0);
+            filled += n;
+
+            const char * const first = buf.data();
+            const char * end = first + filled;
+            if (!eof) {
+                while (end != first && *(end - 1) != '\n') { --end; }
+            }
+            if (end != first) {
+                process_block(first, end, opts, columns, out);
+                out.flush();
+                std::fflush(stdout);
+            }
+            if (eof) { break; }
+            filled = std::copy(end, first + filled, buf.begin())
+                - buf.begin();
+        }
+    }
+}
 
 int main(int argc, char * argv[])
 {
@@ -28,7 +467,27 @@ int main(int argc, char * argv[])
             ("port",     "Print the port")
             ("path",     "Print the path")
             ("query",    "Print the query")
-            ("fragment", "Print the fragment");
+            ("fragment", "Print the fragment")
+            ("bulk",     "Read URIs from standard input, one per line")
+            ("input",    value<string>(),
+                         "Read URIs from the given file, one per line "
+                         "(implies --bulk)")
+            ("format",   value<string>()->default_value("tsv"),
+                         "Bulk output format: tsv or json")
+            ("threads",  value<unsigned>()->default_value(1),
+                         "Number of threads used to parse in bulk mode "
+                         "(0 for one per hardware thread)")
+            ("rule-stats", "Write counts for each grammar rule to standard "
+                           "error (in bulk mode, each URI is also parsed "
+                           "with the grammar to count them)")
+            ("write-index", value<string>(),
+                            "Parse the file given with --input and write a "
+                            "column index of it to the given file, instead "
+                            "of writing its components")
+            ("index",    value<string>(),
+                         "Write the components of the file given with "
+                         "--input from the given column index of it, "
+                         "instead of parsing it");
 
         options_description hidden_opts("Hidden options");
         hidden_opts.add_options()
@@ -50,10 +509,76 @@ int main(int argc, char * argv[])
 
         if (option_map.count("help")) {
             cout << "Usage: parse-uri [options] URI\n"
+                 << "       parse-uri --bulk [options] [--input FILE]\n"
+                 << "\n"
+                 << "In bulk mode, a line is written for each nonempty "
+                    "input line, holding the\n"
+                 << "selected components (all of them if none is "
+                    "selected) in the order below,\n"
+                 << "then whether the line is a URI-reference (if it is "
+                    "not, the components are\n"
+                 << "those of the longest one it starts with).\n"
                  << visible_opts;
             return EXIT_SUCCESS;
         }
 
+        if (option_map.count("write-index") || option_map.count("index")) {
+            if (!option_map.count("input")) {
+                cerr << argv[0] << ": --write-index and --index require "
+                     << "--input" << endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        if (option_map.count("write-index")) {
+            write_index(option_map["input"].as<string>().c_str(),
+                        option_map["write-index"].as<string>().c_str());
+            return EXIT_SUCCESS;
+        }
+
+        if (option_map.count("bulk") || option_map.count("input")) {
+            bulk_options opts;
+            for (std::size_t i = 0; i < component_count; ++i) {
+                if (option_map.count(component_names[i])) {
+                    opts.components.push_back(i);
+                }
+            }
+            if (opts.components.empty()) {
+                for (std::size_t i = 0; i < component_count; ++i) {
+                    opts.components.push_back(i);
+                }
+            }
+            const string & format = option_map["format"].as<string>();
+            if (format != "tsv" && format != "json") {
+                cerr << argv[0] << ": unknown format \"" << format << '"'
+                     << endl;
+                return EXIT_FAILURE;
+            }
+            opts.json = (format == "json");
+            opts.threads = option_map["threads"].as<unsigned>();
+            std::vector<uri::rule_statistics> rule_counts;
+            opts.rule_counts =
+                option_map.count("rule-stats") ? &rule_counts : 0;
+
+            {
+                output_buffer out(1024 * 1024);
+                if (option_map.count("index")) {
+                    process_indexed_file(
+                        option_map["input"].as<string>().c_str(),
+                        option_map["index"].as<string>().c_str(), opts, out);
+                } else if (option_map.count("input")) {
+                    process_file(option_map["input"].as<string>().c_str(),
+                                 opts, out);
+                } else {
+                    process_stdin(opts, out);
+                }
+            }
+            if (opts.rule_counts) { write_rule_stats(rule_counts); }
+            return (std::fflush(stdout) == 0 && !std::ferror(stdout))
+                ? EXIT_SUCCESS
+                : EXIT_FAILURE;
+        }
+
         if (!option_map.count("uri")) {
             cerr << argv[0] << ": required URI argument not given" << endl;
             return EXIT_FAILURE;
@@ -62,7 +587,11 @@ int main(int argc, char * argv[])
         uri::grammar<string::const_iterator> g(c);
         const string & uri = option_map["uri"].as<string>();
         string::const_iterator pos = uri.begin();
-        if (!parse(pos, uri.end(), g)) { return EXIT_FAILURE; }
+        const bool matched = parse(pos, uri.end(), g);
+        if (option_map.count("rule-stats")) {
+            write_rule_stats(uri::rule_snapshot());
+        }
+        if (!matched) { return EXIT_FAILURE; }
 
         if (option_map.count("scheme")) {
             cout << string(c.scheme.begin(), c.scheme.end()) << endl;
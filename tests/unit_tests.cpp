@@ -1,7 +1,104 @@
 // -*- Mode: C++; indent-tabs-mode: nil; c-basic-offset: 4; fill-column: 78 -*-
 #define BOOST_TEST_MODULE uri
 #include <uri/grammar.hpp>
+#include <uri/batch.hpp>
+#include <uri/builder.hpp>
+#include <uri/column_index.hpp>
+#include <uri/compact_uri.hpp>
+#include <uri/extract.hpp>
+#include <uri/normalize.hpp>
+#include <uri/parallel.hpp>
+#include <uri/parse_cache.hpp>
+#include <uri/path.hpp>
+#include <uri/pct_decode.hpp>
+#include <uri/push_parser.hpp>
+#include <uri/query.hpp>
+#include <uri/resolve.hpp>
+#include <uri/scanner.hpp>
+#include <uri/scheme_profile.hpp>
+#include <uri/suffix_trie.hpp>
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+#include <sstream>
+
+namespace {
+
+    typedef std::string::const_iterator iterator;
+
+    //
+    // Inputs for comparing alternative parsers against uri::grammar.
+    //
+    const std::string sample_uris[] = {
+        "http://user@example.com:80/foo/bar?attr=val#frag",
+        "http://example.com:80/foo/bar?attr=val#frag",
+        "http:/foo/bar?attr=val#frag",
+        "http:foo/bar?attr=val#frag",
+        "//user@example.com:80/foo/bar?attr=val#frag",
+        "//example.com:80/foo/bar?attr=val#frag",
+        "/foo/bar?attr=val#frag",
+        "foo/bar?attr=val#frag",
+        "http://user@127.0.0.1:80/foo/bar?attr=val#frag",
+        "http://user@255.255.255.255:80/foo/bar?attr=val#frag",
+        "http://user@[0000:0000:0000:0000:0000:0000:127.0.0.1]:80/foo",
+        "http://user@[::]:80/foo/bar?attr=val#frag",
+        "http://[v1.fe:80]/",
+        "http://[::1",
+        "http://1.2.3.04/",
+        "http://256.1.1.1/",
+        "http://a%2Fb%zz/c",
+        "mailto:a@b?subject=%20hi",
+        "1a:b/c",
+        "a,b:c",
+        "?q#f",
+        ""
+    };
+
+    //
+    // Point every component at the end of u so that components a parser
+    // leaves untouched compare equal.
+    //
+    void reset(uri::components<iterator> & c, const std::string & u)
+    {
+        c.scheme = c.userinfo = c.host = c.port = c.path = c.query =
+            c.fragment = boost::make_iterator_range(u.end(), u.end());
+    }
+
+    bool same_components(const uri::components<iterator> & lhs,
+                         const uri::components<iterator> & rhs)
+    {
+        const boost::iterator_range<iterator>
+            uri::components<iterator>::* const members[] = {
+                &uri::components<iterator>::scheme,
+                &uri::components<iterator>::userinfo,
+                &uri::components<iterator>::host,
+                &uri::components<iterator>::port,
+                &uri::components<iterator>::path,
+                &uri::components<iterator>::query,
+                &uri::components<iterator>::fragment
+            };
+        if (lhs.present != rhs.present) { return false; }
+        for (auto m : members) {
+            if ((lhs.*m).begin() != (rhs.*m).begin()
+                || (lhs.*m).end() != (rhs.*m).end()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //
+    // Parse u with uri::grammar, the reference for the other parsers.
+    //
+    iterator reference_parse(const std::string & u,
+                             uri::components<iterator> & c)
+    {
+        reset(c, u);
+        uri::grammar<iterator> g(c);
+        auto pos = u.begin();
+        BOOST_CHECK(boost::spirit::qi::parse(pos, u.end(), g));
+        return pos;
+    }
+}
 
 BOOST_AUTO_TEST_CASE(ipv4)
 {
@@ -69,4 +166,1210 @@ BOOST_AUTO_TEST_CASE(ipv6)
         BOOST_CHECK(qi::parse(pos, addr.end(), g));
         BOOST_CHECK(pos == addr.end());
     }
+
+    const struct {
+        const char * addr;
+        std::uint16_t value[8];
+    } values[] = {
+        { "1:2:3:4:5:6:7:8", { 1, 2, 3, 4, 5, 6, 7, 8 } },
+        { "1::2",            { 1, 0, 0, 0, 0, 0, 0, 2 } },
+        { "1:2::3:4:5:6",    { 1, 2, 0, 0, 3, 4, 5, 6 } },
+        { "fe80::1:2",       { 0xfe80, 0, 0, 0, 0, 0, 1, 2 } },
+        { "1:2:3:4:5:6:7::", { 1, 2, 3, 4, 5, 6, 7, 0 } },
+        { "::ffff:1.2.3.4",  { 0, 0, 0, 0, 0, 0xffff, 0x0102, 0x0304 } }
+    };
+    for (const auto & v : values) {
+        const std::string addr = v.addr;
+        auto pos = addr.begin();
+        boost::array<std::uint16_t, 8> value;
+        BOOST_CHECK(qi::parse(pos, addr.end(), g, value));
+        BOOST_CHECK(pos == addr.end());
+        BOOST_CHECK_EQUAL_COLLECTIONS(value.begin(), value.end(),
+                                      v.value, v.value + 8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(host_address)
+{
+    const struct {
+        const char * uri;
+        uri::host_type type;
+        std::uint32_t ipv4;
+        std::uint16_t ipv6_last;
+    } cases[] = {
+        { "http://example.com/", uri::reg_name_host, 0, 0 },
+        { "http://10.1.2.3:80/", uri::ipv4_host, 0x0a010203, 0 },
+        { "http://1.2.3.04/", uri::ipv4_host, 0x01020300, 0 },
+        { "http://256.1.1.1/", uri::reg_name_host, 0, 0 },
+        { "http://user@[::1]:80/", uri::ipv6_host, 0, 1 },
+        { "http://[v1.fe:80]/", uri::ipvfuture_host, 0, 0 },
+        { "http://[::1/", uri::reg_name_host, 0, 0 }
+    };
+    for (const auto & test : cases) {
+        const std::string u = test.uri;
+        uri::components<iterator> expected, actual;
+        reference_parse(u, expected);
+        iterator pos = u.begin();
+        uri::scan(pos, u.end(), actual);
+        for (const auto * c : { &expected, &actual }) {
+            BOOST_CHECK_EQUAL(c->address.type, test.type);
+            BOOST_CHECK_EQUAL(c->address.ipv4, test.ipv4);
+            BOOST_CHECK_EQUAL(c->address.ipv6[7], test.ipv6_last);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(char_class_table)
+{
+    using namespace uri::detail;
+
+    static_assert(char_classes('a') & scheme_class, "usable at compile time");
+    static_assert(hex_value('F') == 15, "usable at compile time");
+
+    const std::string pchar =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+        "-._~!$&()*+,;=\\:@";
+    for (int i = 0; i < 256; ++i) {
+        const char c = char(i);
+        const bool in_pchar = c != '\0' && pchar.find(c) != std::string::npos;
+        BOOST_CHECK_EQUAL(bool(char_classes(c) & pchar_class), in_pchar);
+        BOOST_CHECK_EQUAL(bool(char_classes(c) & query_class),
+                          in_pchar || c == '/' || c == '?');
+    }
+    BOOST_CHECK(!(char_classes('\'') & sub_delims_class));
+    BOOST_CHECK(char_classes(',') & scheme_class);
+}
+
+BOOST_AUTO_TEST_CASE(scan)
+{
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> expected, actual;
+        const iterator expected_pos = reference_parse(u, expected);
+
+        reset(actual, u);
+        auto actual_pos = u.begin();
+        BOOST_CHECK(uri::scan(actual_pos, u.end(), actual));
+        BOOST_CHECK(actual_pos == expected_pos);
+        BOOST_CHECK_MESSAGE(same_components(expected, actual),
+                            "component mismatch for \"" << u << '"');
+    }
+}
+
+BOOST_AUTO_TEST_CASE(component_presence)
+{
+    //
+    // Presence is recorded, not inferred from the iterators; so absent
+    // components of ranges over a container whose iterators are checked
+    // (as with _GLIBCXX_DEBUG) are never compared with anything.
+    //
+    typedef std::vector<char>::const_iterator vector_iterator;
+    const uri::base_uri base("http://b/c?d");
+    const struct {
+        const char * uri;
+        unsigned present;
+        const char * normalized;
+        const char * target;
+    } cases[] = {
+        { "HTTP://u@Example.COM:80/a?q#f", 0x7f,
+          "http://u@example.com/a?q#f", "HTTP://u@Example.COM:80/a?q#f" },
+        { "http://a/b", 0x15, "http://a/b", "http://a/b" },
+        { "http://a:/?", 0x3d, "http://a/?", "http://a:/?" },
+        { "x:y#", 0x51, "x:y#", "x:y#" },
+        { "", 0x11, "", "http://b/c?d" }
+    };
+
+    for (const auto & test : cases) {
+        const std::vector<char> u(test.uri,
+                                  test.uri + std::strlen(test.uri));
+        uri::components<vector_iterator> c;
+        vector_iterator pos = u.begin();
+        BOOST_CHECK(uri::scan(pos, u.end(), c));
+        BOOST_CHECK(pos == u.end());
+        BOOST_CHECK_EQUAL(c.present, test.present);
+
+        bool changed;
+        std::vector<char> buf(uri::normalized_length(c, changed));
+        char * end = uri::normalize(c, buf.data(), buf.size());
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), test.normalized);
+
+        buf.resize(base.resolved_length(c));
+        end = base.resolve(c, buf.data());
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), test.target);
+
+        BOOST_CHECK_EQUAL(uri::uri_builder<vector_iterator>(c).str(),
+                          test.uri);
+    }
+
+    const uri::components<vector_iterator> none;
+    BOOST_CHECK_EQUAL(none.present, 0u);
+    BOOST_CHECK_EQUAL(uri::uri_builder<vector_iterator>(none).str(), "");
+}
+
+BOOST_AUTO_TEST_CASE(components_grammar)
+{
+    namespace qi = boost::spirit::qi;
+
+    const uri::components_grammar<iterator> g;
+
+    //
+    // Boost.Test is not thread-safe, so the workers only record what they
+    // find; it is checked once they have finished.
+    //
+    struct result {
+        bool parsed;
+        iterator pos;
+        bool same;
+    };
+
+    const std::size_t n = sizeof sample_uris / sizeof sample_uris[0];
+    std::vector<uri::components<iterator> > expected(n);
+    std::vector<iterator> expected_pos(n);
+    for (std::size_t j = 0; j < n; ++j) {
+        expected_pos[j] = reference_parse(sample_uris[j], expected[j]);
+    }
+
+    std::vector<std::vector<result> > results(4, std::vector<result>(n));
+    boost::thread_group threads;
+    for (auto & thread_results : results) {
+        threads.create_thread([&g, &expected, &thread_results] {
+            for (std::size_t j = 0; j < thread_results.size(); ++j) {
+                const std::string & u = sample_uris[j];
+                uri::components<iterator> actual;
+                reset(actual, u);
+                result & r = thread_results[j];
+                r.pos = u.begin();
+                r.parsed = qi::parse(r.pos, u.end(), g, actual);
+                r.same = same_components(expected[j], actual);
+            }
+        });
+    }
+    threads.join_all();
+
+    for (const auto & thread_results : results) {
+        for (std::size_t j = 0; j < n; ++j) {
+            const result & r = thread_results[j];
+            BOOST_CHECK(r.parsed);
+            BOOST_CHECK(r.pos == expected_pos[j]);
+            BOOST_CHECK_MESSAGE(r.same, "component mismatch for \""
+                                << sample_uris[j] << '"');
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(validator_grammar)
+{
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> c;
+        const iterator expected_pos = reference_parse(u, c);
+        BOOST_CHECK_EQUAL(uri::validate(u.begin(), u.end()),
+                          expected_pos - u.begin());
+    }
+
+    const std::string s = "http://[::1]:8080/a?b#c d";
+    BOOST_CHECK_EQUAL(uri::validate(s.data(), s.data() + s.size()),
+                      std::ptrdiff_t(s.size() - 2));
+}
+
+BOOST_AUTO_TEST_CASE(scheme_profiles)
+{
+    uri::scheme_registry registry;
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> expected;
+        const iterator expected_pos = reference_parse(u, expected);
+
+        uri::profiled_components<iterator> actual;
+        reset(actual, u);
+        auto actual_pos = u.begin();
+        BOOST_CHECK(uri::web_profiles::parse(actual_pos, u.end(), actual));
+        BOOST_CHECK(actual_pos == expected_pos);
+        BOOST_CHECK_MESSAGE(same_components(expected, actual),
+                            "component mismatch for \"" << u << '"');
+
+        reset(actual, u);
+        actual_pos = u.begin();
+        BOOST_CHECK(registry.parse(actual_pos, u.end(), actual));
+        BOOST_CHECK(actual_pos == expected_pos);
+        BOOST_CHECK_MESSAGE(same_components(expected, actual),
+                            "component mismatch for \"" << u << '"');
+    }
+
+    struct {
+        const char * uri;
+        const char * profile;
+        std::uint32_t port_number;
+        bool default_port;
+    } const cases[] = {
+        { "HTTP://example.com/", "http", 80, true },
+        { "http://example.com:/", "http", 80, true },
+        { "https://example.com:443/", "https", 443, true },
+        { "https://example.com:8443/", "https", 8443, false },
+        { "Https://a:80", "https", 80, false },
+        { "http://example.com:99999/", "http", 0, false },
+        { "http:example.com", 0, 0, false },
+        { "ftp://example.com:2121/", 0, 2121, false },
+        { "ftp://example.com/", 0, 0, false }
+    };
+    for (const auto & t : cases) {
+        const char * first = t.uri;
+        const char * const last = first + std::strlen(first);
+        uri::profiled_components<const char *> c;
+        BOOST_CHECK(registry.parse(first, last, c));
+        BOOST_CHECK(first == last);
+        BOOST_CHECK_EQUAL(c.profile == 0, t.profile == 0);
+        if (c.profile && t.profile) {
+            BOOST_CHECK_EQUAL(std::string(c.profile), t.profile);
+        }
+        BOOST_CHECK_EQUAL(c.port_number, t.port_number);
+        BOOST_CHECK_EQUAL(c.default_port, t.default_port);
+    }
+
+    const uri::scheme_profile ftp = { "ftp", 21 };
+    registry.add(ftp);
+    const std::string u = "FTP://example.com/pub";
+    const char * first = u.data();
+    uri::profiled_components<const char *> c;
+    BOOST_CHECK(registry.parse(first, u.data() + u.size(), c));
+    BOOST_CHECK(c.profile && std::string(c.profile) == "ftp");
+    BOOST_CHECK_EQUAL(c.port_number, 21u);
+    BOOST_CHECK(c.default_port);
+    BOOST_CHECK_EQUAL(std::string(c.path.begin(), c.path.end()), "/pub");
+}
+
+#ifdef URI_INSTRUMENT
+BOOST_AUTO_TEST_CASE(rule_statistics)
+{
+    namespace qi = boost::spirit::qi;
+
+    const uri::validator_grammar<iterator> g;
+    uri::reset_rule_statistics();
+
+    boost::thread_group threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.create_thread([&g] {
+            const std::string u = "http://[::1]:80/a";
+            auto pos = u.begin();
+            qi::parse(pos, u.end(), g);
+        });
+    }
+    threads.join_all();
+
+    bool found = false;
+    for (const auto & s : uri::rule_snapshot()) {
+        if (s.name != "ipv6address") { continue; }
+        found = true;
+        BOOST_CHECK_EQUAL(s.invocations, 4u);
+        BOOST_CHECK_EQUAL(s.successes, 4u);
+        BOOST_CHECK_EQUAL(s.backtracks, 0u);
+        BOOST_CHECK_EQUAL(s.bytes, 12u);
+    }
+    BOOST_CHECK(found);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(parse_batch)
+{
+    const std::string buffer =
+        "http://user@example.com:80/foo?attr=val#frag\r\n"
+        "/foo/bar\r\n"
+        "\r\n"
+        "http://example.com/a b\n";
+
+    uri::component_columns columns;
+    uri::parse_batch(buffer.data(), buffer.data() + buffer.size(), columns,
+                     "\r\n");
+
+    BOOST_REQUIRE_EQUAL(columns.size(), 3u);
+
+    const auto text = [&buffer](const uri::offset_range & r) {
+        return buffer.substr(r.begin, r.length);
+    };
+
+    BOOST_CHECK(columns.is_valid(0));
+    BOOST_CHECK_EQUAL(text(columns.scheme[0]), "http");
+    BOOST_CHECK_EQUAL(text(columns.userinfo[0]), "user");
+    BOOST_CHECK_EQUAL(text(columns.host[0]), "example.com");
+    BOOST_CHECK_EQUAL(text(columns.port[0]), "80");
+    BOOST_CHECK_EQUAL(text(columns.path[0]), "/foo");
+    BOOST_CHECK_EQUAL(text(columns.query[0]), "attr=val");
+    BOOST_CHECK_EQUAL(text(columns.fragment[0]), "frag");
+
+    BOOST_CHECK(columns.is_valid(1));
+    BOOST_CHECK_EQUAL(text(columns.uri[1]), "/foo/bar");
+    BOOST_CHECK_EQUAL(text(columns.path[1]), "/foo/bar");
+    BOOST_CHECK(!columns.host[1].present());
+    BOOST_CHECK(!columns.query[1].present());
+
+    BOOST_CHECK(!columns.is_valid(2));
+    BOOST_CHECK_EQUAL(text(columns.path[2]), "/a");
+}
+
+BOOST_AUTO_TEST_CASE(parallel_parse)
+{
+    std::string buffer;
+    for (int i = 0; i < 50000; ++i) {
+        buffer += sample_uris[i % (sizeof sample_uris / sizeof sample_uris[0])];
+        buffer += '\n';
+    }
+
+    uri::component_columns expected, actual;
+    uri::parse_batch(buffer.data(), buffer.data() + buffer.size(), expected);
+    uri::parallel_parse(buffer.data(), buffer.data() + buffer.size(), actual,
+                        "\n", 4);
+
+    BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+    BOOST_CHECK(actual.valid == expected.valid);
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        BOOST_REQUIRE_EQUAL(actual.uri[i].begin, expected.uri[i].begin);
+        BOOST_REQUIRE_EQUAL(actual.path[i].begin, expected.path[i].begin);
+        BOOST_REQUIRE_EQUAL(actual.path[i].length, expected.path[i].length);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(column_index)
+{
+    const std::string buffer =
+        "http://user@example.com:80/foo?attr=val#frag\n"
+        "/foo/bar\n"
+        "\n"
+        "http://192.168.0.1/a b\n"
+        "//[::1]/\n";
+
+    uri::component_columns expected;
+    uri::parse_batch(buffer.data(), buffer.data() + buffer.size(), expected);
+
+    std::ostringstream out;
+    uri::write_column_index(out, buffer.data(),
+                            buffer.data() + buffer.size());
+
+    //
+    // Stand in for a mapping: the index must be aligned.
+    //
+    const std::string file = out.str();
+    std::vector<std::uint64_t> mapped((file.size() + 7) / 8);
+    std::memcpy(mapped.data(), file.data(), file.size());
+
+    const uri::column_index index(mapped.data(), file.size());
+    BOOST_REQUIRE_EQUAL(index.size(), expected.size());
+    BOOST_CHECK_EQUAL(index.source_size(), buffer.size());
+    BOOST_REQUIRE_EQUAL(index.segments().size(), 1u);
+    BOOST_CHECK_EQUAL(index.base(3), 0u);
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        BOOST_CHECK_EQUAL(index.is_valid(i), expected.is_valid(i));
+        BOOST_CHECK_EQUAL(index.uri()[i].begin, expected.uri[i].begin);
+        BOOST_CHECK_EQUAL(index.host()[i].begin, expected.host[i].begin);
+        BOOST_CHECK_EQUAL(index.host()[i].length, expected.host[i].length);
+        BOOST_CHECK_EQUAL(index.fragment()[i].begin,
+                          expected.fragment[i].begin);
+    }
+    BOOST_CHECK_EQUAL(int(index.host_types()[0]), uri::reg_name_host);
+    BOOST_CHECK_EQUAL(int(index.host_types()[2]), uri::ipv4_host);
+    BOOST_CHECK_EQUAL(int(index.host_types()[3]), uri::ipv6_host);
+
+    BOOST_CHECK_THROW(uri::column_index(mapped.data(), file.size() - 1),
+                      std::runtime_error);
+    BOOST_CHECK_THROW(uri::column_index(buffer.data(), buffer.size()),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(parse_cache)
+{
+    typedef boost::iterator_range<const char *> range;
+    const auto same = [](const range & lhs, const range & rhs) {
+        return lhs.begin() == rhs.begin() && lhs.end() == rhs.end();
+    };
+
+    uri::parse_cache cache(64, 4);
+
+    //
+    // Boost.Test is not thread-safe, so each worker counts the parses
+    // that differ from scan's, and the counts are checked afterward.
+    //
+    std::vector<std::size_t> mismatches(4, 0);
+    boost::thread_group threads;
+    for (auto & thread_mismatches : mismatches) {
+        threads.create_thread([&cache, &same, &thread_mismatches] {
+            for (int round = 0; round < 10; ++round) {
+                for (const auto & u : sample_uris) {
+                    //
+                    // A copy, so that hits must map the cached offsets onto
+                    // a different buffer.
+                    //
+                    const std::string text = u;
+                    const char * const first = text.data();
+                    const char * const last = first + text.size();
+
+                    uri::components<const char *> expected, actual;
+                    const char * expected_pos = first;
+                    uri::scan(expected_pos, last, expected);
+                    const char * actual_pos = first;
+                    const bool parsed = cache.parse(actual_pos, last, actual);
+                    if (!parsed
+                        || actual_pos != expected_pos
+                        || actual.present != expected.present
+                        || !same(actual.scheme, expected.scheme)
+                        || !same(actual.userinfo, expected.userinfo)
+                        || !same(actual.host, expected.host)
+                        || !same(actual.port, expected.port)
+                        || !same(actual.path, expected.path)
+                        || !same(actual.query, expected.query)
+                        || !same(actual.fragment, expected.fragment)
+                        || actual.address.type != expected.address.type) {
+                        ++thread_mismatches;
+                    }
+                }
+            }
+        });
+    }
+    threads.join_all();
+
+    for (const std::size_t thread_mismatches : mismatches) {
+        BOOST_CHECK_EQUAL(thread_mismatches, 0u);
+    }
+
+    const std::size_t n = sizeof sample_uris / sizeof sample_uris[0];
+    uri::parse_cache::statistics stats = cache.stats();
+    BOOST_CHECK_EQUAL(stats.hits + stats.misses, 4 * 10 * n);
+    BOOST_CHECK(stats.hits >= 4 * 9 * n);
+    BOOST_CHECK_EQUAL(stats.evictions, 0u);
+
+    //
+    // A cache with room for only a few URIs evicts.
+    //
+    uri::parse_cache small(4, 1);
+    for (const auto & u : sample_uris) {
+        const char * first = u.data();
+        uri::components<const char *> c;
+        small.parse(first, u.data() + u.size(), c);
+    }
+    stats = small.stats();
+    BOOST_CHECK_EQUAL(stats.misses, n);
+    BOOST_CHECK_EQUAL(stats.evictions, n - 4);
+}
+
+BOOST_AUTO_TEST_CASE(push_parser)
+{
+    const auto same = [](const uri::offset_range & lhs,
+                         const uri::offset_range & rhs) {
+        return lhs.begin == rhs.begin
+            && (!lhs.present() || lhs.length == rhs.length);
+    };
+
+    for (const auto & u : sample_uris) {
+        const char * const first = u.data();
+        const char * const last = first + u.size();
+        uri::components<const char *> expected;
+        const char * pos = first;
+        uri::scan(pos, last, expected);
+
+        for (std::size_t chunk = 1; chunk <= u.size() + 1; ++chunk) {
+            uri::push_parser p;
+            for (const char * i = first; i != last;) {
+                const char * const next =
+                    i + std::min<std::size_t>(chunk, last - i);
+                p.feed(i, next);
+                i = next;
+            }
+            p.finish();
+            BOOST_CHECK_MESSAGE((p.state() == uri::push_parser::complete)
+                                == (pos == last),
+                                "status mismatch for \"" << u << '"');
+            if (pos != last) { continue; }
+
+            const uri::offset_components & actual = p.result();
+            using uri::detail::make_offset_range;
+            BOOST_CHECK(same(actual.scheme,
+                             make_offset_range(first, expected.scheme,
+                                               expected.present
+                                               & uri::scheme_present)));
+            BOOST_CHECK(same(actual.userinfo,
+                             make_offset_range(first, expected.userinfo,
+                                               expected.present
+                                               & uri::userinfo_present)));
+            BOOST_CHECK(same(actual.host,
+                             make_offset_range(first, expected.host,
+                                               expected.present
+                                               & uri::host_present)));
+            BOOST_CHECK(same(actual.port,
+                             make_offset_range(first, expected.port,
+                                               expected.present
+                                               & uri::port_present)));
+            BOOST_CHECK(same(actual.path,
+                             make_offset_range(first, expected.path,
+                                               expected.present
+                                               & uri::path_present)));
+            BOOST_CHECK(same(actual.query,
+                             make_offset_range(first, expected.query,
+                                               expected.present
+                                               & uri::query_present)));
+            BOOST_CHECK(same(actual.fragment,
+                             make_offset_range(first, expected.fragment,
+                                               expected.present
+                                               & uri::fragment_present)));
+            BOOST_CHECK_EQUAL(actual.address.type, expected.address.type);
+            BOOST_CHECK_EQUAL(actual.address.ipv4, expected.address.ipv4);
+        }
+    }
+
+    //
+    // Invalid characters are rejected as they arrive, without waiting
+    // for the end of the URI.
+    //
+    const struct {
+        const char * chunk;
+        std::uint32_t offset;
+    } invalid[] = {
+        { "http://exa mple.com/", 10 },
+        { "/a%4g", 4 },
+        { "http://[::1]x", 12 },
+        { "http://1.2.3.45x/", 16 },
+        { "ab:c#d#", 6 }
+    };
+    for (const auto & test : invalid) {
+        const std::string u = test.chunk;
+        uri::push_parser p;
+        BOOST_CHECK_EQUAL(p.feed(u.data(), u.data() + u.size()),
+                          uri::push_parser::failed);
+        BOOST_CHECK_EQUAL(p.offset(), test.offset);
+    }
+
+    //
+    // Until an "@" or the end of the authority, "a:b" may be either
+    // userinfo or host and port.
+    //
+    uri::push_parser p;
+    const std::string u = "http://a:b";
+    BOOST_CHECK_EQUAL(p.feed(u.data(), u.data() + u.size()),
+                      uri::push_parser::partial);
+    BOOST_CHECK_EQUAL(p.finish(), uri::push_parser::failed);
+}
+
+BOOST_AUTO_TEST_CASE(is_uri_reference)
+{
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> c;
+        const bool whole = reference_parse(u, c) == u.end();
+        uri::rejection r;
+        BOOST_CHECK_MESSAGE(
+            uri::is_uri_reference(u.data(), u.data() + u.size(), r) == whole,
+            "disagreement with grammar for \"" << u << '"');
+    }
+
+    typedef uri::push_parser p;
+    struct {
+        const char * uri;
+        std::uint32_t offset;
+        p::component component;
+    } const cases[] = {
+        { "http://exa mple.com/", 10, p::host_component },
+        { "http://host:80 /", 14, p::port_component },
+        { "http://host:80a/", 15, p::userinfo_component },
+        { "http://u:p:q r@h/", 12, p::userinfo_component },
+        { "http://h/pa th", 11, p::path_component },
+        { "http://h/?q=a b", 13, p::query_component },
+        { "#frag#", 5, p::fragment_component },
+        { "ab[c", 2, p::path_component },
+        { "http://[::1", 11, p::host_component },
+        { "http://[::g]/", 10, p::host_component },
+        { "/a%2", 4, p::path_component }
+    };
+    for (const auto & t : cases) {
+        uri::rejection r;
+        BOOST_CHECK(!uri::is_uri_reference(t.uri, t.uri + std::strlen(t.uri),
+                                           r));
+        BOOST_CHECK_EQUAL(r.offset, t.offset);
+        BOOST_CHECK_EQUAL(r.component, t.component);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pct_decode)
+{
+    //
+    // Long enough to exercise the vectorized runs as well as the tail.
+    //
+    std::string encoded;
+    for (int i = 0; i < 40; ++i) {
+        encoded += "abcdefghijklmnopqrstuvwxyz%41%4a%4A%zz%4-%-";
+    }
+
+    std::string expected;
+    uri::pct_decode(encoded.begin(), encoded.end(),
+                    std::back_inserter(expected));
+    BOOST_CHECK_EQUAL(expected.substr(0, 37),
+                      "abcdefghijklmnopqrstuvwxyzAJJ%zz%4-%-");
+
+    std::vector<char> buf(encoded.size());
+    for (std::size_t offset = 0; offset < 48; ++offset) {
+        const char * const first = encoded.data() + offset;
+        const char * const last = encoded.data() + encoded.size();
+        char * const end = uri::pct_decode(first, last, buf.data());
+        std::string expected_tail;
+        uri::pct_decode(encoded.begin() + offset, encoded.end(),
+                        std::back_inserter(expected_tail));
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), expected_tail);
+    }
+
+    std::string in_place = encoded;
+    char * const in_place_end =
+        uri::pct_decode(&in_place[0], &in_place[0] + in_place.size(),
+                        &in_place[0]);
+    BOOST_CHECK_EQUAL(std::string(&in_place[0], in_place_end), expected);
+
+    const auto view = uri::pct_decoded(
+        boost::make_iterator_range(encoded.begin(), encoded.end()));
+    BOOST_CHECK_EQUAL(std::string(view.begin(), view.end()), expected);
+}
+
+BOOST_AUTO_TEST_CASE(query_parameters)
+{
+    //
+    // Long enough for the delimiter search to take vectorized steps.
+    //
+    std::string query = "utm_source=newsletter_with_a_long_name"
+        "&&utm_campaign=autumn;flag&=empty_key&k%65y=v%61lue&";
+    const char * const first = query.data();
+    const char * const last = first + query.size();
+    const auto parameters =
+        uri::query_parameters(boost::make_iterator_range(first, last));
+
+    std::vector<std::pair<std::string, std::string> > actual;
+    for (const auto & p : parameters) {
+        actual.push_back(std::make_pair(
+            std::string(p.key.begin(), p.key.end()),
+            std::string(p.value.begin(), p.value.end())));
+    }
+    const std::pair<std::string, std::string> expected[] = {
+        { "utm_source", "newsletter_with_a_long_name" },
+        { "utm_campaign", "autumn" },
+        { "flag", "" },
+        { "", "empty_key" },
+        { "k%65y", "v%61lue" }
+    };
+    BOOST_CHECK((actual == std::vector<std::pair<std::string, std::string> >(
+                     std::begin(expected), std::end(expected))));
+
+    const auto found =
+        uri::find_parameter(boost::make_iterator_range(first, last), "key");
+    BOOST_REQUIRE(found != parameters.end());
+    const auto value = uri::pct_decoded(found->value);
+    BOOST_CHECK_EQUAL(std::string(value.begin(), value.end()), "value");
+    BOOST_CHECK(uri::find_parameter(boost::make_iterator_range(first, last),
+                                    std::string("missing"))
+                == parameters.end());
+
+    //
+    // Other iterators take the scalar search.
+    //
+    const auto generic = uri::query_parameters(
+        boost::make_iterator_range(query.cbegin(), query.cend()));
+    BOOST_CHECK_EQUAL(std::distance(generic.begin(), generic.end()),
+                      std::distance(parameters.begin(), parameters.end()));
+}
+
+BOOST_AUTO_TEST_CASE(compact_uri)
+{
+    BOOST_CHECK_EQUAL(sizeof (uri::compact_uri), sizeof (void *));
+
+    struct arena {
+        std::vector<std::uint32_t> storage;
+        std::size_t used;
+
+        arena(): storage(1024), used(0) {}
+
+        void * allocate(const std::size_t n)
+        {
+            void * const p = &this->storage[this->used];
+            this->used += (n + 3) / 4;
+            return p;
+        }
+    } pool;
+
+    const uri::compact_uri::component which[] = {
+        uri::compact_uri::scheme_component,
+        uri::compact_uri::userinfo_component,
+        uri::compact_uri::host_component,
+        uri::compact_uri::port_component,
+        uri::compact_uri::path_component,
+        uri::compact_uri::query_component,
+        uri::compact_uri::fragment_component
+    };
+
+    std::vector<uri::compact_uri> uris;
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> c;
+        iterator pos = u.begin();
+        uri::scan(pos, u.end(), c);
+        if (pos != u.end()) {
+            BOOST_CHECK_THROW(uri::compact_uri{u}, std::invalid_argument);
+            continue;
+        }
+
+        const uri::compact_uri owned(u.begin(), u.end(), c);
+        const uri::compact_uri placed(u.begin(), u.end(), c, pool);
+        for (const auto * compact : { &owned, &placed }) {
+            BOOST_CHECK_EQUAL(std::string(compact->text().begin(),
+                                          compact->text().end()), u);
+            const uri::components<const char *> actual =
+                compact->to_components();
+            const boost::iterator_range<iterator> * const expected[] = {
+                &c.scheme, &c.userinfo, &c.host, &c.port, &c.path, &c.query,
+                &c.fragment
+            };
+            for (std::size_t i = 0; i < 7; ++i) {
+                const auto r = compact->get(which[i]);
+                BOOST_CHECK_EQUAL(compact->has(which[i]),
+                                  (c.present & (1u << i)) != 0);
+                if (compact->has(which[i])) {
+                    BOOST_CHECK_EQUAL(
+                        std::string(r.begin(), r.end()),
+                        std::string(expected[i]->begin(),
+                                    expected[i]->end()));
+                }
+            }
+            BOOST_CHECK_EQUAL(actual.present, c.present);
+            BOOST_CHECK(actual.path.begin() == compact->path().begin());
+        }
+        uris.push_back(placed);
+        uris.push_back(uri::compact_uri(u));
+    }
+
+    //
+    // Moves leave the text where it is.
+    //
+    const char * const text = uris.front().text().begin();
+    uri::compact_uri moved(std::move(uris.front()));
+    BOOST_CHECK(uris.front().empty());
+    BOOST_CHECK(moved.text().begin() == text);
+
+    //
+    // Long enough for 32-bit offsets.
+    //
+    const std::string long_uri =
+        "http://example.com/" + std::string(70000, 'a') + "?q";
+    const uri::compact_uri wide(long_uri);
+    BOOST_CHECK_EQUAL(wide.query().begin() - wide.text().begin(), 70020);
+    BOOST_CHECK_EQUAL(std::string(wide.host().begin(), wide.host().end()),
+                      "example.com");
+}
+
+BOOST_AUTO_TEST_CASE(uri_builder)
+{
+    typedef uri::compact_uri c;
+
+    //
+    // With nothing replaced, the builder writes what it was parsed from.
+    //
+    for (const auto & u : sample_uris) {
+        uri::components<iterator> parsed;
+        iterator pos = u.begin();
+        uri::scan(pos, u.end(), parsed);
+        if (pos != u.end()) { continue; }
+        const uri::uri_builder<iterator> b(parsed);
+        BOOST_CHECK_EQUAL(b.length(), u.size());
+        BOOST_CHECK_EQUAL(b.str(), u);
+        BOOST_CHECK(b.validate());
+    }
+
+    const std::string u = "http://user@Example.com:8080/a/b?x=1#top";
+    uri::components<iterator> parsed;
+    iterator pos = u.begin();
+    uri::scan(pos, u.end(), parsed);
+
+    uri::uri_builder<iterator> b(parsed);
+    b.set(c::scheme_component, "https")
+     .remove(c::port_component)
+     .remove(c::userinfo_component)
+     .set(c::query_component, "q=%20");
+    BOOST_CHECK(b.validate());
+    const std::string expected = "https://Example.com/a/b?q=%20#top";
+    BOOST_REQUIRE_EQUAL(b.length(), expected.size());
+    char buffer[64];
+    char * const end = b.write(buffer);
+    BOOST_CHECK_EQUAL(std::string(buffer, end), expected);
+
+    std::string out;
+    out.reserve(64);
+    const char * const data = out.data();
+    b.write(out);
+    BOOST_CHECK_EQUAL(out, expected);
+    BOOST_CHECK(out.data() == data);
+
+    //
+    // Empty components keep their delimiters; absent ones do not.
+    //
+    b.set(c::query_component, "").remove(c::fragment_component)
+     .set(c::port_component, "");
+    BOOST_CHECK_EQUAL(b.str(), "https://Example.com:/a/b?");
+
+    //
+    // From nothing.
+    //
+    uri::uri_builder<iterator> fresh;
+    BOOST_CHECK_EQUAL(fresh.str(), "");
+    fresh.set(c::scheme_component, "mailto")
+         .set(c::path_component, "a@b.example");
+    BOOST_CHECK(fresh.validate());
+    BOOST_CHECK_EQUAL(fresh.str(), "mailto:a@b.example");
+
+    //
+    // Pieces that do not match their rules.
+    //
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .set(c::query_component, "a b").validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .set(c::scheme_component, "1http").validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .set(c::host_component, "a/b").validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .set(c::port_component, "80a").validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .set(c::path_component, "a/b").validate());
+    BOOST_CHECK(uri::uri_builder<iterator>(parsed)
+                .set(c::host_component, "[::1]").validate());
+
+    //
+    // Paths that no longer fit where they end up.
+    //
+    const std::string v = "http://h//x";
+    uri::components<iterator> slashes;
+    pos = v.begin();
+    uri::scan(pos, v.end(), slashes);
+    BOOST_CHECK(uri::uri_builder<iterator>(slashes).validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(slashes)
+                .remove(c::host_component).validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>(parsed)
+                .remove(c::host_component).remove(c::scheme_component)
+                .set(c::path_component, "a:b").validate());
+    BOOST_CHECK(!uri::uri_builder<iterator>()
+                .set(c::port_component, "80").validate());
+}
+
+BOOST_AUTO_TEST_CASE(path_segments)
+{
+    const struct {
+        const char * path;
+        std::size_t count;
+        const char * joined;
+    } cases[] = {
+        { "", 0, "" },
+        { "/", 1, "[]" },
+        { "/a/b", 2, "[a][b]" },
+        { "/a/b/", 3, "[a][b][]" },
+        { "a//b", 3, "[a][][b]" },
+        { "/api/v1/users/with_a_long_identifier_0123456789/profile", 5,
+          "[api][v1][users][with_a_long_identifier_0123456789][profile]" }
+    };
+    for (const auto & test : cases) {
+        const std::string path = test.path;
+        const auto range =
+            boost::make_iterator_range(path.data(), path.data() + path.size());
+        std::string joined;
+        for (const auto & segment : uri::path_segments(range)) {
+            joined += '[' + std::string(segment.begin(), segment.end()) + ']';
+        }
+        BOOST_CHECK_EQUAL(joined, test.joined);
+        BOOST_CHECK_EQUAL(uri::segment_count(range), test.count);
+        BOOST_CHECK_EQUAL(
+            uri::segment_count(
+                boost::make_iterator_range(path.cbegin(), path.cend())),
+            test.count);
+
+        const uri::segment_index<const char *, 2> index(range);
+        BOOST_CHECK_EQUAL(index.size(), std::min<std::size_t>(test.count, 2));
+        BOOST_CHECK_EQUAL(index.complete(), test.count <= 2);
+    }
+
+    const std::string path = "/api/v1/users/42";
+    const uri::segment_index<std::string::const_iterator, 2> index(
+        boost::make_iterator_range(path.cbegin(), path.cend()));
+    BOOST_CHECK_EQUAL(std::string(index[0].begin(), index[0].end()), "api");
+    BOOST_CHECK_EQUAL(std::string(index[1].begin(), index[1].end()), "v1");
+    BOOST_CHECK_EQUAL(std::string(index.rest().begin(), index.rest().end()),
+                      "users/42");
+}
+
+BOOST_AUTO_TEST_CASE(extract_uris)
+{
+    const std::string text =
+        "12:34:56 See http://example.com/a?b=c, or WWW.Example.org:8080/x."
+        " Mail: <https://u@[::1]/p> awww.no ://no 1http://a.b/"
+        " and a long tail with nothing in it at all, ww, :/ and : / :/";
+
+    std::vector<std::string> found;
+    std::vector<std::string> hosts;
+    for (const auto & u : uri::extract_uris(text.data(),
+                                            text.data() + text.size())) {
+        BOOST_CHECK(text.data() + u.offset == u.text.begin());
+        found.push_back(std::string(u.text.begin(), u.text.end()));
+        hosts.push_back(std::string(u.components.host.begin(),
+                                    u.components.host.end()));
+    }
+
+    const std::string expected[] = {
+        "http://example.com/a?b=c,",
+        "WWW.Example.org:8080/x.",
+        "https://u@[::1]/p",
+        "http://a.b/"
+    };
+    const std::string expected_hosts[] = {
+        "example.com", "WWW.Example.org", "[::1]", "a.b"
+    };
+    BOOST_CHECK_EQUAL_COLLECTIONS(found.begin(), found.end(),
+                                  expected, expected + 4);
+    BOOST_CHECK_EQUAL_COLLECTIONS(hosts.begin(), hosts.end(),
+                                  expected_hosts, expected_hosts + 4);
+
+    //
+    // Every alignment of a candidate relative to the vector loads.
+    //
+    for (std::size_t pad = 0; pad < 70; ++pad) {
+        const std::string s = std::string(pad, ' ') + "x ftp://h/ y";
+        const auto uris = uri::extract_uris(s.data(), s.data() + s.size());
+        BOOST_REQUIRE(uris.begin() != uris.end());
+        BOOST_CHECK_EQUAL(uris.begin()->offset, pad + 2);
+        BOOST_CHECK_EQUAL(uris.begin()->text.size(), 8);
+        BOOST_CHECK(std::next(uris.begin()) == uris.end());
+    }
+
+    const std::string none(1000, 'a');
+    BOOST_CHECK(uri::extract_uris(none.data(), none.data() + none.size())
+                .empty());
+}
+
+BOOST_AUTO_TEST_CASE(suffix_trie)
+{
+    std::istringstream list(
+        "// A few entries of the Public Suffix List\n"
+        "com\n"
+        "uk\n"
+        "co.uk\n"
+        "\n"
+        "*.ck\n"
+        "!www.ck\n"
+        "  Blogspot.com  trailing words are ignored\r\n");
+    const uri::suffix_trie trie(list);
+
+    const auto check = [&trie](const std::string & host,
+                               const std::string & suffix,
+                               const std::string & registrable_domain) {
+        const uri::suffix_match<iterator> m =
+            trie.match(boost::make_iterator_range(host.begin(),
+                                                  host.end()));
+        BOOST_CHECK_EQUAL(std::string(m.suffix.begin(), m.suffix.end()),
+                          suffix);
+        BOOST_CHECK_EQUAL(std::string(m.registrable_domain.begin(),
+                                      m.registrable_domain.end()),
+                          registrable_domain);
+        BOOST_CHECK_EQUAL(m.listed(), !suffix.empty());
+        BOOST_CHECK_EQUAL(m.has_registrable_domain,
+                          !registrable_domain.empty());
+    };
+
+    check("www.example.com", "com", "example.com");
+    check("WWW.Example.CO.UK", "CO.UK", "Example.CO.UK");
+    check("example.co.uk.", "co.uk", "example.co.uk");
+    check("a.b.blogspot.COM", "blogspot.COM", "b.blogspot.COM");
+    check("co.uk", "co.uk", "");
+    check(".com", "com", "");
+    check("a..com", "com", "");
+    check("..co.uk", "co.uk", "");
+    check("a.b.ck", "b.ck", "a.b.ck");
+    check("www.ck", "ck", "www.ck");
+    check("a.www.ck", "ck", "www.ck");
+    check("ck", "", "");
+    check("example.org", "", "");
+    check("com.org", "", "");
+    check("", "", "");
+
+    const std::string buffer =
+        "http://a.example.co.uk/\n"
+        "http://127.0.0.1/\n"
+        "/no/host\n"
+        "mailto:x@example.com\n"
+        "//b.example.com:80\n";
+    uri::component_columns columns;
+    uri::parse_batch(buffer.data(), buffer.data() + buffer.size(), columns);
+    std::vector<uri::offset_range> suffix, registrable_domain;
+    trie.match(buffer.data(), columns, suffix, registrable_domain);
+
+    BOOST_REQUIRE_EQUAL(suffix.size(), columns.size());
+    BOOST_REQUIRE_EQUAL(registrable_domain.size(), columns.size());
+    const auto text = [&buffer](const uri::offset_range & r) {
+        return r.present() ? buffer.substr(r.begin, r.length) : "-";
+    };
+    const std::string expected_suffix[] = { "co.uk", "-", "-", "-", "com" };
+    const std::string expected_domain[] = {
+        "example.co.uk", "-", "-", "-", "example.com"
+    };
+    for (std::size_t row = 0; row < columns.size(); ++row) {
+        BOOST_CHECK_EQUAL(text(suffix[row]), expected_suffix[row]);
+        BOOST_CHECK_EQUAL(text(registrable_domain[row]),
+                          expected_domain[row]);
+    }
+
+    std::istringstream bad(std::string(64, 'a') + ".com\n");
+    BOOST_CHECK_THROW(uri::suffix_trie t(bad), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(normalize)
+{
+    const struct {
+        const char * uri;
+        const char * normalized;
+    } cases[] = {
+        { "http://example.com/a/b", "http://example.com/a/b" },
+        { "HTTP://User@Example.COM:80/", "http://User@example.com/" },
+        { "https://example.com:443/a", "https://example.com/a" },
+        { "https://example.com:80/a", "https://example.com:80/a" },
+        { "http://example.com:/a", "http://example.com/a" },
+        { "http://%7euser@a/%7Efoo%2fbar%3a?%61=%2F#%7e",
+          "http://~user@a/~foo%2Fbar%3A?a=%2F#~" },
+        { "http://%41%2e.B/", "http://a..b/" },
+        { "http://a/%25%41b%2f%7e?%2541#%41%25",
+          "http://a/%25Ab%2F~?%2541#A%25" },
+        { "http://a/b/c/./../../g", "http://a/g" },
+        { "http://a/b/c/.", "http://a/b/c/" },
+        { "http://a/b/c/..", "http://a/b/" },
+        { "http://a/b/c/%2E%2e/d", "http://a/b/d" },
+        { "http://a/../../g", "http://a/g" },
+        { "http://a/b/..g/.g/g.", "http://a/b/..g/.g/g." },
+        { "x:./a", "x:a" },
+        { "x:../../a/./b", "x:a/b" },
+        { "x:a/..", "x:/" },
+        { "x:a/../b", "x:/b" },
+        { "x:..", "x:" },
+        { "mid/content=5/../6", "mid/content=5/../6" },
+        { "//Example.COM:80/./a", "//example.com:80/./a" },
+        { "?q#f", "?q#f" },
+        { "", "" }
+    };
+
+    for (const auto & test : cases) {
+        const std::string u = test.uri;
+        uri::components<iterator> c;
+        iterator pos = u.begin();
+        uri::scan(pos, u.end(), c);
+        BOOST_REQUIRE(pos == u.end());
+
+        bool changed;
+        const std::size_t length = uri::normalized_length(c, changed);
+        std::vector<char> buf(length + 1, '*');
+        char * const end = uri::normalize(c, buf.data(), length);
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), test.normalized);
+        BOOST_CHECK_EQUAL(std::size_t(end - buf.data()), length);
+        BOOST_CHECK_EQUAL(buf[length], '*');
+        std::fill(buf.begin(), buf.end(), '*');
+        BOOST_CHECK(uri::normalize(c, buf.data()) == end);
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), test.normalized);
+        BOOST_CHECK_EQUAL(changed, u != test.normalized);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(resolve)
+{
+    //
+    // RFC 3986, section 5.4.
+    //
+    const uri::base_uri base("http://a/b/c/d;p?q");
+    const struct {
+        const char * reference;
+        const char * target;
+    } cases[] = {
+        { "g:h", "g:h" },
+        { "g", "http://a/b/c/g" },
+        { "./g", "http://a/b/c/g" },
+        { "g/", "http://a/b/c/g/" },
+        { "/g", "http://a/g" },
+        { "//g", "http://g" },
+        { "?y", "http://a/b/c/d;p?y" },
+        { "g?y", "http://a/b/c/g?y" },
+        { "#s", "http://a/b/c/d;p?q#s" },
+        { "g#s", "http://a/b/c/g#s" },
+        { "g?y#s", "http://a/b/c/g?y#s" },
+        { ";x", "http://a/b/c/;x" },
+        { "g;x", "http://a/b/c/g;x" },
+        { "g;x?y#s", "http://a/b/c/g;x?y#s" },
+        { "", "http://a/b/c/d;p?q" },
+        { ".", "http://a/b/c/" },
+        { "./", "http://a/b/c/" },
+        { "..", "http://a/b/" },
+        { "../", "http://a/b/" },
+        { "../g", "http://a/b/g" },
+        { "../..", "http://a/" },
+        { "../../", "http://a/" },
+        { "../../g", "http://a/g" },
+        { "../../../g", "http://a/g" },
+        { "../../../../g", "http://a/g" },
+        { "/./g", "http://a/g" },
+        { "/../g", "http://a/g" },
+        { "g.", "http://a/b/c/g." },
+        { ".g", "http://a/b/c/.g" },
+        { "g..", "http://a/b/c/g.." },
+        { "..g", "http://a/b/c/..g" },
+        { "./../g", "http://a/b/g" },
+        { "./g/.", "http://a/b/c/g/" },
+        { "g/./h", "http://a/b/c/g/h" },
+        { "g/../h", "http://a/b/c/h" },
+        { "g;x=1/./y", "http://a/b/c/g;x=1/y" },
+        { "g;x=1/../y", "http://a/b/c/y" },
+        { "g?y/./x", "http://a/b/c/g?y/./x" },
+        { "g?y/../x", "http://a/b/c/g?y/../x" },
+        { "g#s/./x", "http://a/b/c/g#s/./x" },
+        { "g#s/../x", "http://a/b/c/g#s/../x" },
+        { "http:g", "http:g" }
+    };
+
+    const std::size_t n = sizeof cases / sizeof cases[0];
+    std::vector<std::string> references;
+    for (const auto & test : cases) { references.push_back(test.reference); }
+    std::vector<uri::components<iterator> > parsed(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::string & reference = references[i];
+        iterator pos = reference.begin();
+        uri::scan(pos, reference.end(), parsed[i]);
+        BOOST_REQUIRE(pos == reference.end());
+
+        std::vector<char> buf(base.resolved_length(parsed[i]));
+        char * const end = base.resolve(parsed[i], buf.data());
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), cases[i].target);
+    }
+
+    std::string arena = "x";
+    std::vector<uri::offset_range> targets;
+    base.resolve(parsed.begin(), parsed.end(), arena, targets);
+    BOOST_REQUIRE_EQUAL(targets.size(), n);
+    for (std::size_t i = 0; i < n; ++i) {
+        BOOST_CHECK_EQUAL(arena.substr(targets[i].begin, targets[i].length),
+                          cases[i].target);
+    }
+
+    //
+    // Bases without an authority, and with dot-segments of their own.
+    //
+    BOOST_CHECK_THROW(uri::base_uri("a/b"), std::invalid_argument);
+    const struct {
+        const char * base;
+        const char * reference;
+        const char * target;
+    } more[] = {
+        { "x:a", "b", "x:b" },
+        { "x:a/b", "c", "x:a/c" },
+        { "x:a/b", "../../c", "x:/c" },
+        { "x:./b", "c", "x:c" },
+        { "x:../../b", "../c", "x:c" },
+        { "x:.//b", "c", "x:/c" },
+        { "x:/a/./b/../c/d", "e", "x:/a/c/e" },
+        { "x:/a/b/", "..", "x:/a/" },
+        { "http://a", "b", "http://a/b" },
+        { "http://a?q#f", "", "http://a?q" }
+    };
+    for (const auto & test : more) {
+        const std::string reference = test.reference;
+        uri::components<iterator> c;
+        iterator pos = reference.begin();
+        uri::scan(pos, reference.end(), c);
+        const uri::base_uri b(test.base);
+        std::vector<char> buf(b.resolved_length(c));
+        char * const end = b.resolve(c, buf.data());
+        BOOST_CHECK_EQUAL(std::string(buf.data(), end), test.target);
+    }
 }